@@ -1236,8 +1236,12 @@
       YB.ChannelRegistry.updateAllStats(msg);
 
       $("#uptime").html(YB.Util.secondsToDhms(Math.round(msg.uptime / 1000000)));
-      if (msg.fps)
-        $("#fps").html(msg.fps.toLocaleString("en-US") + " hz");
+      if (msg.fps) {
+        let fps = msg.fps.toLocaleString("en-US") + " hz";
+        if (msg.loop_utilization !== undefined)
+          fps += " / " + msg.loop_utilization + "% busy";
+        $("#fps").html(fps);
+      }
 
       if (msg.loop_timer) {
         let totalTime = 0;
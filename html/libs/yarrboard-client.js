@@ -3,6 +3,182 @@
 		const ws = require('websocket');
 		const packageJSON = require('./package.json');
 
+		//minimal MessagePack codec, just the types ArduinoJson uses.
+		const MsgPack = {
+			encode(value) {
+				let bytes = [];
+				MsgPack._encode(value, bytes);
+				return new Uint8Array(bytes);
+			},
+
+			_encode(v, out) {
+				if (v === null || v === undefined)
+					out.push(0xc0);
+				else if (v === false)
+					out.push(0xc2);
+				else if (v === true)
+					out.push(0xc3);
+				else if (typeof v === "number") {
+					if (Number.isInteger(v) && v >= 0 && v < 128)
+						out.push(v);
+					else if (Number.isInteger(v) && v < 0 && v >= -32)
+						out.push(v & 0xff);
+					else if (Number.isInteger(v) && v >= 0 && v <= 0xffffffff)
+						MsgPack._push(out, 0xce, 4, (dv) => dv.setUint32(0, v));
+					else if (Number.isInteger(v) && v < 0 && v >= -0x80000000)
+						MsgPack._push(out, 0xd2, 4, (dv) => dv.setInt32(0, v));
+					else
+						MsgPack._push(out, 0xcb, 8, (dv) => dv.setFloat64(0, v));
+				}
+				else if (typeof v === "string") {
+					let str = new TextEncoder().encode(v);
+					if (str.length < 32)
+						out.push(0xa0 | str.length);
+					else if (str.length < 0x100)
+						out.push(0xd9, str.length);
+					else if (str.length < 0x10000)
+						out.push(0xda, str.length >> 8, str.length & 0xff);
+					else
+						MsgPack._push(out, 0xdb, 4, (dv) => dv.setUint32(0, str.length));
+					for (let b of str)
+						out.push(b);
+				}
+				else if (Array.isArray(v)) {
+					MsgPack._header(out, v.length, 0x90, 0xdc);
+					for (let item of v)
+						MsgPack._encode(item, out);
+				}
+				else if (typeof v === "object") {
+					let keys = Object.keys(v).filter((k) => v[k] !== undefined);
+					MsgPack._header(out, keys.length, 0x80, 0xde);
+					for (let k of keys) {
+						MsgPack._encode(k, out);
+						MsgPack._encode(v[k], out);
+					}
+				}
+				else
+					out.push(0xc0);
+			},
+
+			_header(out, length, fix, base) {
+				if (length < 16)
+					out.push(fix | length);
+				else if (length < 0x10000)
+					out.push(base, length >> 8, length & 0xff);
+				else
+					MsgPack._push(out, base + 1, 4, (dv) => dv.setUint32(0, length));
+			},
+
+			_push(out, type, size, write) {
+				let dv = new DataView(new ArrayBuffer(size));
+				write(dv);
+				out.push(type);
+				for (let i = 0; i < size; i++)
+					out.push(dv.getUint8(i));
+			},
+
+			decode(buffer) {
+				let state = { dv: new DataView(buffer), pos: 0 };
+				return MsgPack._decode(state);
+			},
+
+			_decode(s) {
+				let dv = s.dv;
+				let type = dv.getUint8(s.pos++);
+				let value;
+
+				if (type < 0x80)
+					return type;
+				if (type >= 0xe0)
+					return type - 0x100;
+				if ((type & 0xf0) == 0x80)
+					return MsgPack._map(s, type & 0x0f);
+				if ((type & 0xf0) == 0x90)
+					return MsgPack._array(s, type & 0x0f);
+				if ((type & 0xe0) == 0xa0)
+					return MsgPack._str(s, type & 0x1f);
+
+				switch (type) {
+					case 0xc0: return null;
+					case 0xc2: return false;
+					case 0xc3: return true;
+					case 0xc4: return MsgPack._bin(s, dv.getUint8(s.pos++));
+					case 0xc5: value = dv.getUint16(s.pos); s.pos += 2; return MsgPack._bin(s, value);
+					case 0xc6: value = dv.getUint32(s.pos); s.pos += 4; return MsgPack._bin(s, value);
+					case 0xca: value = dv.getFloat32(s.pos); s.pos += 4; return value;
+					case 0xcb: value = dv.getFloat64(s.pos); s.pos += 8; return value;
+					case 0xcc: return dv.getUint8(s.pos++);
+					case 0xcd: value = dv.getUint16(s.pos); s.pos += 2; return value;
+					case 0xce: value = dv.getUint32(s.pos); s.pos += 4; return value;
+					case 0xcf: value = Number(dv.getBigUint64(s.pos)); s.pos += 8; return value;
+					case 0xd0: return dv.getInt8(s.pos++);
+					case 0xd1: value = dv.getInt16(s.pos); s.pos += 2; return value;
+					case 0xd2: value = dv.getInt32(s.pos); s.pos += 4; return value;
+					case 0xd3: value = Number(dv.getBigInt64(s.pos)); s.pos += 8; return value;
+					case 0xd9: return MsgPack._str(s, dv.getUint8(s.pos++));
+					case 0xda: value = dv.getUint16(s.pos); s.pos += 2; return MsgPack._str(s, value);
+					case 0xdb: value = dv.getUint32(s.pos); s.pos += 4; return MsgPack._str(s, value);
+					case 0xdc: value = dv.getUint16(s.pos); s.pos += 2; return MsgPack._array(s, value);
+					case 0xdd: value = dv.getUint32(s.pos); s.pos += 4; return MsgPack._array(s, value);
+					case 0xde: value = dv.getUint16(s.pos); s.pos += 2; return MsgPack._map(s, value);
+					case 0xdf: value = dv.getUint32(s.pos); s.pos += 4; return MsgPack._map(s, value);
+				}
+
+				throw new Error(`Unsupported MessagePack type 0x${type.toString(16)}`);
+			},
+
+			_str(s, length) {
+				let bytes = new Uint8Array(s.dv.buffer, s.dv.byteOffset + s.pos, length);
+				s.pos += length;
+				return new TextDecoder().decode(bytes);
+			},
+
+			_bin(s, length) {
+				let bytes = new Uint8Array(s.dv.buffer.slice(s.dv.byteOffset + s.pos, s.dv.byteOffset + s.pos + length));
+				s.pos += length;
+				return bytes;
+			},
+
+			_array(s, length) {
+				let arr = new Array(length);
+				for (let i = 0; i < length; i++)
+					arr[i] = MsgPack._decode(s);
+				return arr;
+			},
+
+			_map(s, length) {
+				let obj = {};
+				for (let i = 0; i < length; i++) {
+					let key = MsgPack._decode(s);
+					obj[key] = MsgPack._decode(s);
+				}
+				return obj;
+			}
+		};
+
+		//fold a delta update into the last full one.  arrays of objects are matched up by id.
+		function mergeUpdate(state, delta) {
+			for (const key of Object.keys(delta)) {
+				const value = delta[key];
+				const current = state[key];
+
+				if (Array.isArray(value) && Array.isArray(current) && value.length && value[0].id !== undefined) {
+					for (const item of value) {
+						const existing = current.find(e => e.id == item.id);
+						if (existing)
+							mergeUpdate(existing, item);
+						else
+							current.push(item);
+					}
+				}
+				else if (value && current && typeof value === 'object' && typeof current === 'object' && !Array.isArray(value) && !Array.isArray(current))
+					mergeUpdate(current, value);
+				else
+					state[key] = value;
+			}
+			return state;
+		}
+
 		class YarrboardClient {
 			constructor(hostname = "yarrboard.local", username = "admin", password = "admin", require_login = true, use_ssl = false) {
 				this.config = false;
@@ -19,11 +195,19 @@
 				this.boardname = hostname.split(".")[0];
 				this.use_ssl = use_ssl;
 
+				//"json" or "msgpack".  msgpack is asked for in hello and only used if the board agrees.
+				this.encoding = "json";
+				this.binary = false;
+
+				//last full update, so get_update only needs to send what changed
+				this.updateState = null;
+
 				this.addMessageId = false;
 				this.messageQueue = [];
 				this.lastMessage = {};
 				this.lastMessageId = 0;
 				this.lastMessageTime = 0;
+				this.pendingMessageIds = new Set();
 				this.messageTimeout = 5000;
 				this.messageTimeoutCount = 0;
 
@@ -125,7 +309,7 @@
 									//this.lastMessage.msgid = this.lastMessage.msgid;
 									//this.lastMessageId = this.lastMessage.msgid;
 									this.lastMessageTime = Date.now();
-									this.ws.send(JSON.stringify(this.lastMessage));
+									this._wsSend(this.lastMessage);
 								}
 							}
 						} else {
@@ -146,7 +330,7 @@
 							}
 
 							//finally send it off.
-							this.ws.send(JSON.stringify(message));
+							this._wsSend(message);
 						}
 					} catch (error) {
 						this.log(`Send error: ${error}`);
@@ -169,6 +353,18 @@
 				//should we add it to the queue?
 				if (requireConfirmation)
 					this.messageQueue.push(message);
+				else
+					this._wsSend(message);
+			}
+
+			//several commands in one frame, the board replies with an array
+			sendBatch(messages) {
+				this._wsSend(messages);
+			}
+
+			_wsSend(message) {
+				if (this.binary)
+					this.ws.send(MsgPack.encode(message));
 				else
 					this.ws.send(JSON.stringify(message));
 			}
@@ -190,7 +386,11 @@
 			}
 
 			sayHello(requireConfirmation = true) {
-				return this.send({ "cmd": "hello" }, requireConfirmation);
+				let hello = { "cmd": "hello" };
+				if (this.encoding == "msgpack")
+					hello.encoding = "msgpack";
+
+				return this.send(hello, requireConfirmation);
 			}
 
 			getConfig(requireConfirmation = true) {
@@ -206,7 +406,31 @@
 			}
 
 			getUpdate(requireConfirmation = false) {
-				return this.send({ "cmd": "get_update" }, requireConfirmation);
+				let message = { "cmd": "get_update" };
+
+				//only ask for what changed since the last one we have
+				if (this.updateState && this.updateState.version)
+					message.since = this.updateState.version;
+
+				return this.send(message, requireConfirmation);
+			}
+
+			//only get updates for one controller, or one channel of it
+			subscribe(controller, channel = null, requireConfirmation = true) {
+				let message = { "cmd": "subscribe", "controller": controller };
+				if (channel !== null)
+					message.channel = channel;
+				return this.send(message, requireConfirmation);
+			}
+
+			//no controller means all of them, and back to getting everything
+			unsubscribe(controller = null, channel = null, requireConfirmation = true) {
+				let message = { "cmd": "unsubscribe" };
+				if (controller !== null)
+					message.controller = controller;
+				if (channel !== null)
+					message.channel = channel;
+				return this.send(message, requireConfirmation);
 			}
 
 			startUpdatePoller(update_interval) {
@@ -335,6 +559,7 @@
 
 				//okay, connect
 				this.ws = new ws.w3cwebsocket(uri);
+				this.ws.binaryType = "arraybuffer";
 				this.ws.onopen = this._onopen.bind(this);
 				this.ws.onerror = this._onerror.bind(this);
 				this.ws.onclose = this._onclose.bind(this);
@@ -355,6 +580,10 @@
 				this.messageQueue = [];
 				this.connectionRetryCount = 0;
 
+				//every connection starts out as json, with a full update
+				this.binary = false;
+				this.updateState = null;
+
 				//handle login
 				if (this.require_login)
 					this.login(this.username, this.password);
@@ -392,45 +621,74 @@
 			_onmessage(event) {
 				this.receivedMessageCount++;
 
-				if (typeof event.data === 'string') {
+				if (typeof event.data === 'string' || event.data instanceof ArrayBuffer) {
 					try {
-						let data = JSON.parse(event.data);
+						let data;
+						if (typeof event.data === 'string')
+							data = JSON.parse(event.data);
+						else
+							data = MsgPack.decode(event.data);
+
+						//batched commands get an array of replies back
+						for (data of (Array.isArray(data) ? data : [data])) {
+							//handlers always see a full update
+							if (data.msg == "update" && data.version) {
+								if (!data.delta)
+									this.updateState = data;
+								else if (this.updateState)
+									data = mergeUpdate(this.updateState, data);
+								else
+									continue;
+								delete this.updateState.delta;
+							}
 
-						//check for a message reply.
-						if (data.msgid) {
-							if (data.msgid == this.lastMessageId) {
-								this.lastMessageId = 0;
-								this.messageTimeoutCount = 0;
+							//did the board agree to binary?
+							if (data.msg == "hello" && data.encoding)
+								this.binary = (data.encoding == "msgpack");
+
+							//check for a message reply.
+							if (data.msgid) {
+								if (data.msgid == this.lastMessageId) {
+									this.lastMessageId = 0;
+									this.messageTimeoutCount = 0;
+
+									//the real reply comes later, no need to hold up the queue
+									if (data.status == "pending")
+										this.pendingMessageIds.add(data.msgid);
+								}
+								else if (this.pendingMessageIds.has(data.msgid)) {
+									this.pendingMessageIds.delete(data.msgid);
+								}
+								else {
+									this.log(`unknown msgid ${data.msgid}, looking for ${this.lastMessageId}`);
+									this.log(JSON.stringify(data));
+								}
 							}
-							else {
-								this.log(`unknown msgid ${data.msgid}, looking for ${this.lastMessageId}`);
-								this.log(JSON.stringify(data));
+
+							//status?
+							if (data.status == "error")
+								this.log(`Error: ${data.message}`);
+							if (data.status == "success")
+								this.log(`Success: ${data.message}`);
+
+							//are we doing an OTA?
+							if (data.msg == "ota_progress")
+								this.ota_started = true;
+
+							//did we get a throttle message?
+							if (data.error == "Queue Full") {
+								//this.messageQueueDelay = Math.round(10 * (1 + Math.random()));
+								this.messageQueueDelay = this.messageQueueDelay + 25 + 25 * Math.random();
+								this.messageQueueDelay = Math.min(this.messageQueueDelayMax, this.messageQueueDelay)
+								this.log(`Throttling: ${this.messageQueueDelay}`);
 							}
-						}
 
-						//status?
-						if (data.status == "error")
-							this.log(`Error: ${data.message}`);
-						if (data.status == "success")
-							this.log(`Success: ${data.message}`);
-
-						//are we doing an OTA?
-						if (data.msg == "ota_progress")
-							this.ota_started = true;
-
-						//did we get a throttle message?
-						if (data.error == "Queue Full") {
-							//this.messageQueueDelay = Math.round(10 * (1 + Math.random()));
-							this.messageQueueDelay = this.messageQueueDelay + 25 + 25 * Math.random();
-							this.messageQueueDelay = Math.min(this.messageQueueDelayMax, this.messageQueueDelay)
-							this.log(`Throttling: ${this.messageQueueDelay}`);
+							//this is our heartbeat reply, ignore
+							if (data.pong)
+								true;
+							else
+								this.onmessage(data, event);
 						}
-
-						//this is our heartbeat reply, ignore
-						if (data.pong)
-							true;
-						else
-							this.onmessage(data, event);
 					}
 					catch (error) {
 						this.log(`Message error: ${error.message}`);
@@ -0,0 +1,91 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_BROADCAST_BUFFER_H
+#define YARR_BROADCAST_BUFFER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <new>
+
+/**
+ * BroadcastBuffer
+ * One serialized message, shared by every send it goes out on.
+ *
+ * - it is created with one reference, owned by whoever created it.
+ * - retain() once per pending send, and release() when that send completes.
+ * - the last release() frees it, from whichever task that happens on.
+ */
+class BroadcastBuffer
+{
+  public:
+    static BroadcastBuffer* create(size_t len)
+    {
+      // header and payload in one allocation
+      void* mem = malloc(sizeof(BroadcastBuffer) + len);
+      if (mem == nullptr)
+        return nullptr;
+
+      return new (mem) BroadcastBuffer(len);
+    }
+
+    static BroadcastBuffer* fromBytes(const void* data, size_t len)
+    {
+      BroadcastBuffer* b = create(len);
+      if (b != nullptr)
+        memcpy(b->data(), data, len);
+
+      return b;
+    }
+
+    static BroadcastBuffer* fromJson(JsonVariantConst doc)
+    {
+      size_t len = measureJson(doc);
+      BroadcastBuffer* b = create(len);
+      if (b != nullptr)
+        serializeJson(doc, (char*)b->data(), len);
+
+      return b;
+    }
+
+    static BroadcastBuffer* fromMsgPack(JsonVariantConst doc)
+    {
+      size_t len = measureMsgPack(doc);
+      BroadcastBuffer* b = create(len);
+      if (b != nullptr)
+        serializeMsgPack(doc, b->data(), len);
+
+      return b;
+    }
+
+    void retain() { _refs.fetch_add(1, std::memory_order_relaxed); }
+
+    void release()
+    {
+      if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        this->~BroadcastBuffer();
+        free(this);
+      }
+    }
+
+    uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+    size_t length() const { return _len; }
+
+  private:
+    BroadcastBuffer(size_t len) : _refs(1), _len(len) {}
+
+    std::atomic<uint16_t> _refs;
+    size_t _len;
+};
+
+#endif /* !YARR_BROADCAST_BUFFER_H */
@@ -0,0 +1,116 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_COMMAND_TABLE_H
+#define YARR_COMMAND_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * CommandTable
+ * Open addressing hash of name -> index into somebody else's list, so a lookup is
+ * one hash and usually one strcmp instead of a strcmp against every entry.
+ *
+ * - the list is anything with size() and operator[], whose entries have a `command` string.
+ * - it only holds indexes, so rebuild() it whenever the list changes.
+ * - rebuild() tries a few seeds and keeps the one with the fewest extra probes.
+ * - not thread safe, the owner does the locking.
+ */
+template <size_t SIZE>
+class CommandTable
+{
+  public:
+    static_assert((SIZE & (SIZE - 1)) == 0, "CommandTable size must be a power of 2");
+
+    static constexpr uint8_t EMPTY_SLOT = 0xFF;
+    static constexpr uint32_t MAX_SEEDS = 32;
+
+    CommandTable() { memset(_slots, EMPTY_SLOT, sizeof(_slots)); }
+
+    // FNV-1a, seeded so we can go looking for a collision free table
+    static uint32_t hash(const char* name, uint32_t seed)
+    {
+      uint32_t hash = 2166136261u ^ seed;
+      while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+      }
+      return hash;
+    }
+
+    template <typename List>
+    void rebuild(const List& list)
+    {
+      // 0 = perfect hash, no need to keep looking
+      uint32_t bestSeed = 0;
+      uint32_t bestProbes = UINT32_MAX;
+      for (uint32_t seed = 0; seed < MAX_SEEDS && bestProbes; seed++) {
+        uint32_t probes = _fill(list, seed);
+        if (probes < bestProbes) {
+          bestProbes = probes;
+          bestSeed = seed;
+        }
+      }
+
+      _probes = _fill(list, bestSeed);
+      _seed = bestSeed;
+    }
+
+    // index into the list, or -1
+    template <typename List>
+    int find(const List& list, const char* name) const
+    {
+      if (name == nullptr)
+        return -1;
+
+      uint32_t slot = hash(name, _seed) & MASK;
+      while (_slots[slot] != EMPTY_SLOT) {
+        if (!strcmp(list[_slots[slot]].command, name))
+          return _slots[slot];
+        slot = (slot + 1) & MASK;
+      }
+
+      return -1;
+    }
+
+    uint32_t seed() const { return _seed; }
+    uint32_t probes() const { return _probes; }
+
+  private:
+    static constexpr uint32_t MASK = SIZE - 1;
+
+    uint8_t _slots[SIZE];
+    uint32_t _seed = 0;
+    uint32_t _probes = 0;
+
+    template <typename List>
+    uint32_t _fill(const List& list, uint32_t seed)
+    {
+      memset(_slots, EMPTY_SLOT, sizeof(_slots));
+
+      uint32_t probes = 0;
+      for (size_t i = 0; i < list.size(); i++) {
+        uint32_t slot = hash(list[i].command, seed) & MASK;
+        while (_slots[slot] != EMPTY_SLOT) {
+          probes++;
+          slot = (slot + 1) & MASK;
+        }
+        _slots[slot] = i;
+      }
+
+      return probes;
+    }
+};
+
+#endif /* !YARR_COMMAND_TABLE_H */
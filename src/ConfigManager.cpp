@@ -11,6 +11,7 @@
  */
 
 #include "ConfigManager.h"
+#include "JsonStream.h"
 #include "YarrboardApp.h"
 #include "YarrboardDebug.h"
 
@@ -79,33 +80,18 @@ bool ConfigManager::saveConfig(char* error, size_t len)
   // generate a full new document each time
   generateFullConfig(config);
 
-  // dynamically allocate our buffer
-  size_t jsonSize = measureJson(config);
-  char* jsonBuffer = (char*)malloc(jsonSize + 1);
-
-  // now serialize it to the buffer
-  if (jsonBuffer != NULL) {
-    jsonBuffer[jsonSize] = '\0'; // null terminate
-    serializeJson(config, jsonBuffer, jsonSize + 1);
-  } else {
-    snprintf(error, len, "saveConfig() failed to create buffer of size %d", jsonSize);
-    return false;
-  }
-
   // write our config to local storage
   File fp = LittleFS.open(YB_BOARD_CONFIG_PATH, "w");
   if (!fp) {
     snprintf(error, len, "Failed to open %s for writing", YB_BOARD_CONFIG_PATH);
-    free(jsonBuffer);
     return false;
   }
 
-  // check write result
-  size_t bytesWritten = fp.print((char*)jsonBuffer);
-  if (bytesWritten == 0) {
+  // stream it to the file in small chunks
+  PrintJsonStream stream(fp);
+  if (!stream.sendJson(config) || stream.bytesSent() == 0) {
     fp.close();
     strncpy(error, "Failed to write JSON data to file", len);
-    free(jsonBuffer);
     return false;
   }
 
@@ -116,7 +102,6 @@ bool ConfigManager::saveConfig(char* error, size_t len)
   // confirm file exists and has non-zero length
   if (!LittleFS.exists(YB_BOARD_CONFIG_PATH)) {
     strncpy(error, "File not found after write", len);
-    free(jsonBuffer);
     return false;
   }
 
@@ -125,13 +110,11 @@ bool ConfigManager::saveConfig(char* error, size_t len)
   if (!verify || verify.size() == 0) {
     verify.close();
     strncpy(error, "Wrote file but it appears empty or unreadable", len);
-    free(jsonBuffer);
     return false;
   }
   verify.close();
 
-  // free up our memory
-  free(jsonBuffer);
+  _app.events.publish(YBEvent(YB_EVENT_CONFIG_SAVED));
 
   return true;
 }
@@ -177,13 +160,13 @@ void ConfigManager::generateBoardConfig(JsonVariant output)
 
   // hook for our hardware capabilities
   JsonObject capabilities = output["capabilities"].to<JsonObject>();
-  for (const auto& entry : _app.getControllers()) {
-    entry.controller->generateCapabilitiesHook(capabilities);
+  for (BaseController* c : _app.getHookSubscribers(YB_HOOK_CAPABILITIES)) {
+    c->generateCapabilitiesHook(capabilities);
   }
 
   // hook for each controller
-  for (const auto& entry : _app.getControllers()) {
-    entry.controller->generateConfigHook(output);
+  for (BaseController* c : _app.getHookSubscribers(YB_HOOK_CONFIG)) {
+    c->generateConfigHook(output);
   }
 }
 
@@ -426,8 +409,8 @@ bool ConfigManager::loadBoardConfigFromJSON(JsonVariant config, char* error, siz
   const char* v = config["name"] | _app.board_name;
   strlcpy(board_name, v, sizeof(board_name));
 
-  for (const auto& entry : _app.getControllers()) {
-    entry.controller->loadConfigHook(config, error, len);
+  for (BaseController* c : _app.getHookSubscribers(YB_HOOK_LOAD_CONFIG)) {
+    c->loadConfigHook(config, error, len);
   }
 
   return result;
@@ -0,0 +1,98 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_CONTROLLER_HANDLE_H
+#define YARR_CONTROLLER_HANDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Typed reference to a registered controller, returned by YarrboardApp::registerController().
+// Resolving one is a single indexed load plus a generation check, no name lookup or casting.
+template <typename T>
+struct ControllerHandle {
+    static constexpr uint8_t NO_SLOT = 0xFF;
+
+    uint8_t slot = NO_SLOT;
+    uint8_t generation = 0;
+
+    bool isValid() const { return slot != NO_SLOT; }
+    explicit operator bool() const { return isValid(); }
+};
+
+/**
+ * HandleTable
+ * Stable slots behind ControllerHandle.  A slot never moves while its controller is
+ * registered, and its generation changes on removal so old handles go stale.
+ */
+template <typename Base, size_t CAPACITY>
+class HandleTable
+{
+  public:
+    static_assert(CAPACITY < ControllerHandle<Base>::NO_SLOT, "too many slots for a ControllerHandle");
+
+    // slot index, or -1 if full
+    int add(Base* item)
+    {
+      for (size_t i = 0; i < CAPACITY; i++) {
+        if (_slots[i].item == nullptr) {
+          _slots[i].item = item;
+          return i;
+        }
+      }
+      return -1;
+    }
+
+    void remove(Base* item)
+    {
+      for (Slot& slot : _slots) {
+        if (slot.item == item) {
+          slot.item = nullptr;
+          slot.generation++;
+        }
+      }
+    }
+
+    template <typename T>
+    ControllerHandle<T> handle(int slot) const
+    {
+      ControllerHandle<T> h;
+      if (slot >= 0 && (size_t)slot < CAPACITY) {
+        h.slot = slot;
+        h.generation = _slots[slot].generation;
+      }
+      return h;
+    }
+
+    // nullptr if it was removed
+    template <typename T>
+    T* get(ControllerHandle<T> h) const
+    {
+      if (h.slot >= CAPACITY)
+        return nullptr;
+
+      const Slot& s = _slots[h.slot];
+      if (s.generation != h.generation)
+        return nullptr;
+
+      return static_cast<T*>(s.item);
+    }
+
+  private:
+    struct Slot {
+        Base* item = nullptr;
+        uint8_t generation = 0;
+    };
+    Slot _slots[CAPACITY];
+};
+
+#endif /* !YARR_CONTROLLER_HANDLE_H */
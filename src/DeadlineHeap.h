@@ -0,0 +1,81 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_DEADLINE_HEAP_H
+#define YARR_DEADLINE_HEAP_H
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * DeadlineHeap
+ * Fixed size min-heap of pointers, earliest getNextLoopMillis() first.  Anything that
+ * isn't due yet costs nothing until it reaches the front.
+ *
+ * - deadlines are compared with a signed difference, so millis() rollover is fine.
+ * - change an item's deadline only while it is popped, or clear() and push everything again.
+ */
+template <typename T, size_t CAPACITY>
+class DeadlineHeap
+{
+  public:
+    bool push(T* item)
+    {
+      if (_size == CAPACITY)
+        return false;
+
+      _items[_size++] = item;
+      std::push_heap(_items, _items + _size, later);
+      return true;
+    }
+
+    T* pop()
+    {
+      std::pop_heap(_items, _items + _size, later);
+      return _items[--_size];
+    }
+
+    // the earliest one, if it is due
+    T* due(uint32_t now) const
+    {
+      if (_size && (int32_t)(now - _items[0]->getNextLoopMillis()) >= 0)
+        return _items[0];
+      return nullptr;
+    }
+
+    T* front() const { return _size ? _items[0] : nullptr; }
+    bool empty() const { return _size == 0; }
+    size_t size() const { return _size; }
+    void clear() { _size = 0; }
+
+    // std::*_heap() keeps the "largest" element at the front, so this is inverted
+    static bool later(T* a, T* b)
+    {
+      return (int32_t)(a->getNextLoopMillis() - b->getNextLoopMillis()) > 0;
+    }
+
+    // next deadline after a run.  no catching up on missed runs, we just skip ahead.
+    static uint32_t advance(uint32_t deadline, uint32_t interval, uint32_t now)
+    {
+      deadline += interval;
+      if ((int32_t)(now - deadline) >= 0)
+        deadline = now + interval;
+      return deadline;
+    }
+
+  private:
+    T* _items[CAPACITY];
+    size_t _size = 0;
+};
+
+#endif /* !YARR_DEADLINE_HEAP_H */
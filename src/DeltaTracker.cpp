@@ -0,0 +1,209 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include "DeltaTracker.h"
+#include <esp_random.h>
+
+static const uint32_t FNV_OFFSET = 2166136261u;
+static const uint32_t FNV_PRIME = 16777619u;
+
+// hashes whatever gets serialized into it, so we never need a buffer
+class HashPrint : public Print
+{
+  public:
+    uint32_t hash = FNV_OFFSET;
+
+    size_t write(uint8_t c) override
+    {
+      hash ^= c;
+      hash *= FNV_PRIME;
+      return 1;
+    }
+
+    size_t write(const uint8_t* data, size_t len) override
+    {
+      for (size_t i = 0; i < len; i++)
+        write(data[i]);
+      return len;
+    }
+};
+
+DeltaTracker::DeltaTracker()
+{
+  static_assert((YB_UPDATE_FIELD_TABLE_SIZE & (YB_UPDATE_FIELD_TABLE_SIZE - 1)) == 0,
+    "YB_UPDATE_FIELD_TABLE_SIZE must be a power of 2");
+
+  // random starting point, so a client holding a version from before a reboot gets a full update
+  _version = (esp_random() & 0xFFFFFF) + 1;
+}
+
+uint32_t DeltaTracker::update(JsonVariantConst state)
+{
+  _next = _version + 1;
+  _changed = false;
+
+  _stamp(state, FNV_OFFSET);
+
+  if (_changed)
+    _version = _next;
+
+  return _version;
+}
+
+void DeltaTracker::generateDelta(JsonVariantConst state, uint32_t since, JsonVariant output)
+{
+  _diff(state, FNV_OFFSET, since, output);
+}
+
+void DeltaTracker::_stamp(JsonVariantConst value, uint32_t path)
+{
+  if (value.is<JsonObjectConst>()) {
+    for (JsonPairConst kv : value.as<JsonObjectConst>())
+      _stamp(kv.value(), _hashKey(path, kv.key().c_str()));
+    return;
+  }
+
+  if (_isKeyedArray(value)) {
+    for (JsonVariantConst element : value.as<JsonArrayConst>())
+      _stamp(element, _hashId(path, element["id"]));
+    return;
+  }
+
+  Field* f = _find(path, true);
+  if (f == nullptr)
+    return;
+
+  uint32_t hash = _hashValue(value);
+  if (f->version == 0 || f->value != hash) {
+    f->value = hash;
+    f->version = _next;
+    _changed = true;
+  }
+}
+
+bool DeltaTracker::_diff(JsonVariantConst value, uint32_t path, uint32_t since, JsonVariant output)
+{
+  bool found = false;
+
+  // output is already the right container, we just fill it in
+  if (value.is<JsonObjectConst>()) {
+    JsonObject out = output.as<JsonObject>();
+    for (JsonPairConst kv : value.as<JsonObjectConst>()) {
+      const char* key = kv.key().c_str();
+      uint32_t childPath = _hashKey(path, key);
+
+      if (kv.value().is<JsonObjectConst>()) {
+        if (_diff(kv.value(), childPath, since, out[key].to<JsonObject>()))
+          found = true;
+        else
+          out.remove(key);
+      } else if (_isKeyedArray(kv.value())) {
+        if (_diff(kv.value(), childPath, since, out[key].to<JsonArray>()))
+          found = true;
+        else
+          out.remove(key);
+      } else if (_versionOf(childPath) > since) {
+        out[key] = kv.value();
+        found = true;
+      }
+    }
+  } else {
+    JsonArray out = output.as<JsonArray>();
+    for (JsonVariantConst element : value.as<JsonArrayConst>()) {
+      JsonObject item = out.add<JsonObject>();
+      if (_diff(element, _hashId(path, element["id"]), since, item)) {
+        // the client needs to know which one it is
+        item["id"] = element["id"];
+        found = true;
+      } else
+        out.remove(out.size() - 1);
+    }
+  }
+
+  return found;
+}
+
+uint32_t DeltaTracker::_versionOf(uint32_t path)
+{
+  // untracked fields always count as changed
+  Field* f = _find(path, false);
+  return f != nullptr ? f->version : _version;
+}
+
+DeltaTracker::Field* DeltaTracker::_find(uint32_t path, bool create)
+{
+  const uint32_t mask = YB_UPDATE_FIELD_TABLE_SIZE - 1;
+
+  // 0 marks an empty slot
+  if (path == 0)
+    path = 1;
+
+  uint32_t slot = path & mask;
+  for (uint32_t probes = 0; probes < YB_UPDATE_FIELD_TABLE_SIZE; probes++) {
+    Field& f = _fields[slot];
+    if (f.path == path)
+      return &f;
+
+    if (f.path == 0) {
+      // keep it at most 3/4 full so lookups stay short
+      if (!create || _fieldCount >= YB_UPDATE_FIELD_TABLE_SIZE * 3 / 4) {
+        if (create)
+          overflows++;
+        return nullptr;
+      }
+
+      f.path = path;
+      _fieldCount++;
+      return &f;
+    }
+
+    slot = (slot + 1) & mask;
+  }
+
+  return nullptr;
+}
+
+bool DeltaTracker::_isKeyedArray(JsonVariantConst value)
+{
+  if (!value.is<JsonArrayConst>())
+    return false;
+
+  JsonArrayConst arr = value.as<JsonArrayConst>();
+  return arr.size() && !arr[0]["id"].isNull();
+}
+
+uint32_t DeltaTracker::_hashKey(uint32_t parent, const char* key)
+{
+  uint32_t hash = parent;
+  hash ^= '.';
+  hash *= FNV_PRIME;
+  while (*key) {
+    hash ^= (uint8_t)*key++;
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+uint32_t DeltaTracker::_hashId(uint32_t parent, JsonVariantConst id)
+{
+  HashPrint hasher;
+  hasher.hash = parent ^ '#';
+  serializeJson(id, hasher);
+  return hasher.hash;
+}
+
+uint32_t DeltaTracker::_hashValue(JsonVariantConst value)
+{
+  HashPrint hasher;
+  serializeJson(value, hasher);
+  return hasher.hash;
+}
@@ -0,0 +1,71 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_DELTA_TRACKER_H
+#define YARR_DELTA_TRACKER_H
+
+#include "YarrboardConfig.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/**
+ * DeltaTracker
+ * Remembers the version each field of the update message last changed in,
+ * so a client that already has version N only needs the fields stamped after it.
+ *
+ * - fields are keyed by a hash of their path.  array elements with an "id" are
+ *   keyed by that id, any other array is treated as a single value.
+ * - nothing is stored per client, the client sends back the last version it has.
+ * - if the table fills up, the extra fields are simply sent every time.
+ */
+class DeltaTracker
+{
+  public:
+    DeltaTracker();
+
+    // stamp anything that changed since the last call, returns the current version
+    uint32_t update(JsonVariantConst state);
+
+    // copy everything that changed after `since` into output, ids included
+    void generateDelta(JsonVariantConst state, uint32_t since, JsonVariant output);
+
+    // can we build a delta from this version?
+    bool canDelta(uint32_t since) const { return since != 0 && since <= _version; }
+
+    uint32_t version() const { return _version; }
+    uint16_t fieldCount() const { return _fieldCount; }
+    uint32_t overflows = 0;
+
+  private:
+    struct Field {
+        uint32_t path = 0; // 0 is an empty slot
+        uint32_t value = 0;
+        uint32_t version = 0;
+    };
+    Field _fields[YB_UPDATE_FIELD_TABLE_SIZE];
+    uint16_t _fieldCount = 0;
+    uint32_t _version;
+    uint32_t _next;
+    bool _changed;
+
+    void _stamp(JsonVariantConst value, uint32_t path);
+    bool _diff(JsonVariantConst value, uint32_t path, uint32_t since, JsonVariant output);
+    uint32_t _versionOf(uint32_t path);
+    Field* _find(uint32_t path, bool create);
+
+    static bool _isKeyedArray(JsonVariantConst value);
+    static uint32_t _hashKey(uint32_t parent, const char* key);
+    static uint32_t _hashId(uint32_t parent, JsonVariantConst id);
+    static uint32_t _hashValue(JsonVariantConst value);
+};
+
+#endif /* !YARR_DELTA_TRACKER_H */
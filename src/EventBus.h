@@ -0,0 +1,157 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_EVENT_BUS_H
+#define YARR_EVENT_BUS_H
+
+#include "YarrboardConfig.h"
+#include <Arduino.h>
+#include <etl/delegate.h>
+#include <etl/vector.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+typedef enum {
+  YB_EVENT_CHANNEL_CHANGED,    // source = controller name, id = channel id
+  YB_EVENT_CONFIG_SAVED,       //
+  YB_EVENT_BRIGHTNESS_CHANGED, // value = new brightness
+  YB_EVENT_CLIENT_CONNECTED,   // source = transport, id = socket
+  YB_EVENT_CLIENT_DISCONNECTED,
+  YB_EVENT_COUNT
+} YBEventType;
+
+// small and trivially copyable, events are copied by value through the queue
+struct YBEvent {
+    YBEventType type;
+    const char* source; // must be a stable string
+    int32_t id;
+    float value;
+
+    YBEvent(YBEventType type = YB_EVENT_COUNT, const char* source = nullptr, int32_t id = 0, float value = 0)
+        : type(type), source(source), id(id), value(value) {}
+};
+
+/**
+ * EventBus
+ * Fixed capacity, zero allocation publish / subscribe.
+ *
+ * - publish() is safe from any task.  events nobody subscribed to are skipped.
+ * - client connect / disconnect have their own queue, so a burst of channel changes can't
+ *   push them out.  publish() waits a little for room for those, everything else is dropped
+ *   when its queue is full.
+ * - dispatch() is called once per pass from the main loop, so handlers always run there.
+ *   connect / disconnect go first, so their order vs the other events isn't kept.
+ * - subscribe() should be called during setup.
+ */
+class EventBus
+{
+  public:
+    typedef etl::delegate<void(const YBEvent&)> Handler;
+
+    EventBus()
+    {
+      _queue = xQueueCreateStatic(YB_EVENT_QUEUE_SIZE, sizeof(YBEvent), _queueStorage, &_queueBuffer);
+      _lifecycleQueue = xQueueCreateStatic(YB_EVENT_LIFECYCLE_QUEUE_SIZE, sizeof(YBEvent), _lifecycleStorage, &_lifecycleBuffer);
+    }
+
+    // events we can't lose, or clients leak their per-client state
+    static bool isLifecycle(YBEventType type)
+    {
+      return type == YB_EVENT_CLIENT_CONNECTED || type == YB_EVENT_CLIENT_DISCONNECTED;
+    }
+
+    bool hasSubscribers(YBEventType type) { return _subscribed & (1 << type); }
+
+    // who to wake up when an event is published
+    void setConsumer(TaskHandle_t task) { _consumer = task; }
+
+    bool subscribe(YBEventType type, Handler handler)
+    {
+      if (_subscribers.full() || !handler.is_valid())
+        return false;
+
+      _subscribers.push_back({type, handler});
+      _subscribed |= (1 << type);
+      return true;
+    }
+
+    bool publish(const YBEvent& event)
+    {
+      // nobody is listening, don't fill the queue with it
+      if (!hasSubscribers(event.type))
+        return true;
+
+      bool sent;
+      if (isLifecycle(event.type)) {
+        // wait for the main loop to make room, unless we are the main loop
+        bool canWait = !xPortInIsrContext() && xTaskGetCurrentTaskHandle() != _consumer;
+        sent = xQueueSend(_lifecycleQueue, &event, canWait ? pdMS_TO_TICKS(YB_EVENT_LIFECYCLE_WAIT_MS) : 0) == pdTRUE;
+      } else
+        sent = xQueueSend(_queue, &event, 0) == pdTRUE;
+
+      if (!sent) {
+        dropped++;
+        return false;
+      }
+
+      published++;
+      if (_consumer != nullptr)
+        xTaskNotifyGive(_consumer);
+
+      return true;
+    }
+
+    void dispatch()
+    {
+      _dispatch(_lifecycleQueue);
+      _dispatch(_queue);
+    }
+
+    uint32_t published = 0;
+    uint32_t dropped = 0;
+
+  private:
+    struct Subscriber {
+        YBEventType type;
+        Handler handler;
+    };
+
+    etl::vector<Subscriber, YB_EVENT_MAX_SUBSCRIBERS> _subscribers;
+    uint32_t _subscribed = 0; // bitmask of YBEventType
+    static_assert(YB_EVENT_COUNT <= 32, "too many event types for the subscriber mask");
+
+    QueueHandle_t _queue = nullptr;
+    StaticQueue_t _queueBuffer;
+    uint8_t _queueStorage[YB_EVENT_QUEUE_SIZE * sizeof(YBEvent)];
+
+    QueueHandle_t _lifecycleQueue = nullptr;
+    StaticQueue_t _lifecycleBuffer;
+    uint8_t _lifecycleStorage[YB_EVENT_LIFECYCLE_QUEUE_SIZE * sizeof(YBEvent)];
+
+    TaskHandle_t _consumer = nullptr;
+
+    // only what was queued when we started, so a handler publishing can't starve the loop
+    void _dispatch(QueueHandle_t queue)
+    {
+      UBaseType_t pending = uxQueueMessagesWaiting(queue);
+
+      YBEvent event;
+      while (pending-- && xQueueReceive(queue, &event, 0) == pdTRUE) {
+        for (const Subscriber& s : _subscribers) {
+          if (s.type == event.type)
+            s.handler(event);
+        }
+      }
+    }
+};
+
+#endif /* !YARR_EVENT_BUS_H */
@@ -0,0 +1,39 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_HOOK_TRAITS_H
+#define YARR_HOOK_TRAITS_H
+
+#include <type_traits>
+
+/**
+ * HookOwner
+ * Finds the class that declares the version of a virtual hook T ends up calling.
+ * Only the overload with the base hook's exact signature is looked at, so a
+ * controller can add its own overloads of a hook name without confusing it.
+ *
+ *   YB_HOOK_OWNER(MyController, BaseController, generateUpdateHook) -> MyController
+ */
+template <typename Sig>
+struct HookSignature;
+
+template <typename B, typename R, typename... Args>
+struct HookSignature<R (B::*)(Args...)> {
+    // only C is deduced, so only the overload with this signature matches
+    template <typename C>
+    static C* owner(R (C::*)(Args...));
+};
+
+#define YB_HOOK_OWNER(T, Base, name) \
+  typename std::remove_pointer<decltype(HookSignature<decltype(&Base::name)>::owner(&T::name))>::type
+
+#endif /* !YARR_HOOK_TRAITS_H */
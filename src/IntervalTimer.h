@@ -12,7 +12,6 @@
 
 // IntervalTimer.h
 #pragma once
-#include "YarrboardDebug.h"
 #include <Arduino.h>
 #include <cstring>
 #include <stdint.h>
@@ -28,6 +27,7 @@
  * - Call time("label") at the end of a code block to record micros since the last mark.
  * - Call print() to output a summary table of averages to the configured Print device.
  * - Call getEntries() to retrieve raw data for custom processing or JSON serialization.
+ * - start() and time() also take an explicit micros() timestamp if you already have one.
  *
  * Technical Notes:
  * - Rollover-Safe: Uses uint32_t subtraction with micros() to handle hardware timer wrap-around.
@@ -51,14 +51,15 @@ class IntervalTimer
     void setPrinter(Print& printer) { _printer = &printer; }
 
     // Mark the starting point for the next interval.
-    void start() { _last_us = micros(); }
+    void start() { start(micros()); }
+    void start(uint32_t now_us) { _last_us = now_us; }
 
     // Record elapsed time since the most recent start()/time() and attribute it to `label`.
-    void time(const char* label)
+    void time(const char* label) { time(label, micros()); }
+    void time(const char* label, uint32_t now_us)
     {
-      const uint32_t now = micros();
-      const uint32_t delta = now - _last_us; // rollover-safe with unsigned math
-      _last_us = now;
+      const uint32_t delta = now_us - _last_us; // rollover-safe with unsigned math
+      _last_us = now_us;
 
       Entry& e = findOrCreate(label);
       e.total_us += static_cast<uint64_t>(delta);
@@ -0,0 +1,153 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_JSON_STREAM_H
+#define YARR_JSON_STREAM_H
+
+#include "YarrboardConfig.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <PsychicHttp.h>
+
+/**
+ * JsonStream
+ * Serializes a document through a small fixed buffer instead of measuring it
+ * and mallocing a copy of the whole thing.  Subclasses decide where the chunks go.
+ *
+ * - the last chunk is held back until end(), so sinks always know which one is final.
+ * - once a chunk fails to send, the rest of the document is dropped.
+ */
+class JsonStream : public Print
+{
+  public:
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t* data, size_t len) override
+    {
+      size_t written = 0;
+      while (written < len && !_failed) {
+        // only flush when there is more coming
+        if (_used == sizeof(_buffer))
+          _flush(false);
+
+        size_t n = min(len - written, sizeof(_buffer) - _used);
+        memcpy(_buffer + _used, data + written, n);
+        _used += n;
+        written += n;
+      }
+
+      return written;
+    }
+
+    bool sendJson(JsonVariantConst doc)
+    {
+      serializeJson(doc, *this);
+      return end();
+    }
+
+    bool sendMsgPack(JsonVariantConst doc)
+    {
+      serializeMsgPack(doc, *this);
+      return end();
+    }
+
+    // send whatever is left as the final chunk
+    bool end()
+    {
+      if (!_failed && !_ended)
+        _flush(true);
+      _ended = true;
+
+      return !_failed;
+    }
+
+    size_t bytesSent() const { return _sent; }
+
+  protected:
+    // return false to abort the rest of the stream
+    virtual bool sendChunk(const uint8_t* data, size_t len, bool first, bool last) = 0;
+
+  private:
+    void _flush(bool last)
+    {
+      if (sendChunk(_buffer, _used, _sent == 0 && !_flushed, last))
+        _sent += _used;
+      else
+        _failed = true;
+
+      _flushed = true;
+      _used = 0;
+    }
+
+    uint8_t _buffer[YB_JSON_STREAM_BUFFER_SIZE];
+    size_t _used = 0;
+    size_t _sent = 0;
+    bool _flushed = false;
+    bool _failed = false;
+    bool _ended = false;
+};
+
+// anything with a Print interface: files, serial, udp, etc.
+class PrintJsonStream : public JsonStream
+{
+  public:
+    PrintJsonStream(Print& out) : _out(out) {}
+
+  protected:
+    bool sendChunk(const uint8_t* data, size_t len, bool first, bool last) override
+    {
+      return _out.write(data, len) == len;
+    }
+
+  private:
+    Print& _out;
+};
+
+// small responses go out normally, bigger ones use chunked transfer encoding
+class HTTPJsonStream : public JsonStream
+{
+  public:
+    HTTPJsonStream(PsychicResponse* response, const char* contentType = "application/json") : _response(response)
+    {
+      _response->setContentType(contentType);
+    }
+
+    esp_err_t error() const { return _err; }
+
+  protected:
+    bool sendChunk(const uint8_t* data, size_t len, bool first, bool last) override
+    {
+      // it all fit in one buffer
+      if (first && last) {
+        _response->setContent(data, len);
+        _err = _response->send();
+        return _err == ESP_OK;
+      }
+
+      if (first)
+        _response->sendHeaders();
+
+      if (len)
+        _err = _response->sendChunk((uint8_t*)data, len);
+
+      if (last && _err == ESP_OK)
+        _err = _response->finishChunking();
+
+      return _err == ESP_OK;
+    }
+
+  private:
+    PsychicResponse* _response;
+    esp_err_t _err = ESP_OK;
+};
+
+#endif /* !YARR_JSON_STREAM_H */
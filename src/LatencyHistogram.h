@@ -0,0 +1,99 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_LATENCY_HISTOGRAM_H
+#define YARR_LATENCY_HISTOGRAM_H
+
+#include "YarrboardConfig.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/**
+ * LatencyHistogram
+ * Counts durations in power of 2 buckets, so percentiles cost a few bytes per bucket
+ * instead of keeping every sample.
+ *
+ * - bucket 0 is 0us, bucket n is [2^(n-1), 2^n) us, the last one catches everything longer.
+ * - percentiles are the top of the bucket they land in, so they are within 2x and never above max.
+ */
+class LatencyHistogram
+{
+  public:
+    static constexpr uint8_t BUCKETS = YB_LATENCY_HISTOGRAM_BUCKETS;
+
+    void add(uint32_t us)
+    {
+      buckets[bucketFor(us)]++;
+      count++;
+      total += us;
+      if (us > max)
+        max = us;
+    }
+
+    uint32_t percentile(uint8_t pct) const
+    {
+      if (count == 0)
+        return 0;
+
+      // the sample we're looking for, rounded up
+      uint64_t target = ((uint64_t)count * pct + 99) / 100;
+      uint64_t seen = 0;
+      for (uint8_t i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target)
+          return i == BUCKETS - 1 ? max : min(bucketTop(i), max);
+      }
+
+      return max;
+    }
+
+    uint32_t average() const { return count ? total / count : 0; }
+
+    void clear()
+    {
+      memset(buckets, 0, sizeof(buckets));
+      count = 0;
+      total = 0;
+      max = 0;
+    }
+
+    // p50 / p95 / p99 / max, plus the raw buckets if you want them
+    void generateStats(JsonVariant output, bool withBuckets = false) const
+    {
+      output["avg_us"] = average();
+      output["p50_us"] = percentile(50);
+      output["p95_us"] = percentile(95);
+      output["p99_us"] = percentile(99);
+      output["max_us"] = max;
+
+      if (withBuckets) {
+        JsonArray b = output["buckets"].to<JsonArray>();
+        for (uint8_t i = 0; i < BUCKETS; i++)
+          b.add(buckets[i]);
+      }
+    }
+
+    static uint8_t bucketFor(uint32_t us)
+    {
+      uint8_t b = us ? 32 - __builtin_clz(us) : 0;
+      return b < BUCKETS ? b : BUCKETS - 1;
+    }
+
+    static uint32_t bucketTop(uint8_t bucket) { return bucket ? (1UL << bucket) - 1 : 0; }
+
+    uint32_t buckets[BUCKETS] = {};
+    uint32_t count = 0;
+    uint64_t total = 0;
+    uint32_t max = 0;
+};
+
+#endif /* !YARR_LATENCY_HISTOGRAM_H */
@@ -26,6 +26,9 @@
  *   RollingAverage ra(128, 1000);  // 128-sample buffer, 1-second window
  *   ra.add(analogRead(A0));
  *   unsigned int avg = ra.average();       // get average of last 1s of data
+ *
+ * Every method that looks at the clock also has an overload taking an explicit
+ * millisecond timestamp, so callers can share one clock read (e.g. the app's frame clock).
  */
 class RollingAverage
 {
@@ -58,9 +61,11 @@ class RollingAverage
      *
      * @param v The sample value to add.
      */
-    inline void add(uint32_t v)
+    inline void add(uint32_t v) { add(v, millis()); }
+
+    /** @brief Add a new sample value, timestamped with now (ms). */
+    inline void add(uint32_t v, uint32_t now)
     {
-      const uint32_t now = millis();
       prune(now);
 
       // Drop oldest if buffer full
@@ -84,9 +89,12 @@ class RollingAverage
      *             if you've modified data manually or want to verify integrity).
      * @return The average value, or 0. if no valid samples exist.
      */
-    inline uint32_t average(bool fast = true)
+    inline uint32_t average(bool fast = true) { return average(millis(), fast); }
+
+    /** @brief Average as of now (ms). */
+    inline uint32_t average(uint32_t now, bool fast)
     {
-      prune(millis());
+      prune(now);
       if (!count_)
         return 0;
 
@@ -107,9 +115,12 @@ class RollingAverage
      *
      * @return The latest value, or 0 if no samples exist.
      */
-    inline uint32_t latest()
+    inline uint32_t latest() { return latest(millis()); }
+
+    /** @brief Latest value as of now (ms). */
+    inline uint32_t latest(uint32_t now)
     {
-      prune(millis());
+      prune(now);
       if (!count_)
         return 0;
       const uint16_t last = (tail_ == 0) ? (cap_ - 1) : (tail_ - 1);
@@ -119,9 +130,12 @@ class RollingAverage
     /**
      * @brief Get the number of valid samples currently inside the time window.
      */
-    inline uint16_t count()
+    inline uint16_t count() { return count(millis()); }
+
+    /** @brief Sample count as of now (ms). */
+    inline uint16_t count(uint32_t now)
     {
-      prune(millis());
+      prune(now);
       return count_;
     }
 
@@ -149,9 +163,12 @@ class RollingAverage
      * @param i The index of the sample to retrieve (0 to count-1).
      * @return The sample value at index i, or 0 if index is out of range.
      */
-    inline uint32_t get(uint16_t i)
+    inline uint32_t get(uint16_t i) { return get(i, millis()); }
+
+    /** @brief Sample value at index i as of now (ms). */
+    inline uint32_t get(uint16_t i, uint32_t now)
     {
-      prune(millis());
+      prune(now);
       if (i >= count_)
         return 0;
       const uint16_t idx = (head_ + i) % cap_;
@@ -0,0 +1,205 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include "SerialFramer.h"
+#include "JsonStream.h"
+
+bool SerialFramer::poll()
+{
+  if (_ready)
+    return true;
+
+  // maybe the last read already brought in the next frame
+  if (_extractFrame())
+    return true;
+
+  // only what is already there, never wait for more
+  while (_port.available() > 0) {
+    size_t space = YB_SERIAL_RX_BUFFER_SIZE - _used;
+
+    // too big for us, keep the tail so we can find the delimiter and start over after it
+    if (space == 0) {
+      if (!_discarding)
+        overflows++;
+      _discarding = true;
+      _used = 0;
+      _scanned = 0;
+      space = YB_SERIAL_RX_BUFFER_SIZE;
+    }
+
+    size_t want = min((size_t)_port.available(), space);
+    size_t got = _port.readBytes(_rx + _used, want);
+    if (got == 0)
+      break;
+    _used += got;
+
+    if (_extractFrame())
+      return true;
+  }
+
+  return false;
+}
+
+bool SerialFramer::_extractFrame()
+{
+  uint8_t delimiter = _delimiter();
+
+  while (_scanned < _used) {
+    uint8_t* end = (uint8_t*)memchr(_rx + _scanned, delimiter, _used - _scanned);
+    if (end == nullptr) {
+      _scanned = _used;
+      return false;
+    }
+
+    size_t len = end - _rx;
+    _frameEnd = len + 1;
+
+    // that was the end of a frame we had to throw away
+    if (_discarding) {
+      _discarding = false;
+      consume();
+      continue;
+    }
+
+    // line mode tolerates \r\n, and ignores blank lines
+    if (_framing == YB_SERIAL_FRAMING_LINE) {
+      while (len && (_rx[len - 1] == '\r' || _rx[len - 1] == ' '))
+        len--;
+    } else if (len && !cobsDecode(_rx, len, len)) {
+      errors++;
+      consume();
+      continue;
+    }
+
+    if (len == 0) {
+      consume();
+      continue;
+    }
+
+    // null terminate it, the parser is happier that way
+    _rx[len] = '\0';
+    _frameLen = len;
+    _ready = true;
+    frames++;
+    return true;
+  }
+
+  return false;
+}
+
+void SerialFramer::consume()
+{
+  // shift whatever came in after this frame to the front
+  size_t rest = _used > _frameEnd ? _used - _frameEnd : 0;
+  if (rest)
+    memmove(_rx, _rx + _frameEnd, rest);
+
+  _used = rest;
+  _scanned = 0;
+  _frameEnd = 0;
+  _frameLen = 0;
+  _ready = false;
+}
+
+void SerialFramer::writeFrame(JsonVariantConst doc, bool msgpack)
+{
+  if (_framing == YB_SERIAL_FRAMING_COBS) {
+    _port.write((uint8_t)0);
+    CobsPrint cobs(_port);
+    if (msgpack)
+      bytesMsgPack += serializeMsgPack(doc, cobs);
+    else
+      bytesJson += serializeJson(doc, cobs);
+    cobs.end();
+    _port.write((uint8_t)0);
+  }
+  // msgpack isn't line safe, so lines are always json
+  else {
+    PrintJsonStream stream(_port);
+    stream.sendJson(doc);
+    bytesJson += stream.bytesSent();
+    _port.println();
+  }
+}
+
+void SerialFramer::writeFrame(const char* data, size_t len)
+{
+  // already serialized, and only ever json
+  bytesJson += len;
+
+  if (_framing == YB_SERIAL_FRAMING_COBS) {
+    _port.write((uint8_t)0);
+    CobsPrint cobs(_port);
+    cobs.write((const uint8_t*)data, len);
+    cobs.end();
+    _port.write((uint8_t)0);
+  } else {
+    _port.write((const uint8_t*)data, len);
+    _port.println();
+  }
+}
+
+// in place, the output never gets ahead of the input
+bool SerialFramer::cobsDecode(uint8_t* data, size_t len, size_t& decodedLen)
+{
+  size_t in = 0;
+  size_t out = 0;
+
+  while (in < len) {
+    uint8_t code = data[in++];
+    if (code == 0 || in + code - 1 > len)
+      return false;
+
+    for (uint8_t i = 1; i < code; i++)
+      data[out++] = data[in++];
+
+    // every block but a full one ends in a zero, except the last
+    if (code != 0xFF && in < len)
+      data[out++] = 0;
+  }
+
+  decodedLen = out;
+  return true;
+}
+
+size_t CobsPrint::write(uint8_t c)
+{
+  if (c == 0) {
+    _out.write((uint8_t)(_used + 1));
+    _out.write(_block, _used);
+    _used = 0;
+    return 1;
+  }
+
+  _block[_used++] = c;
+  if (_used == sizeof(_block)) {
+    _out.write((uint8_t)0xFF);
+    _out.write(_block, _used);
+    _used = 0;
+  }
+
+  return 1;
+}
+
+size_t CobsPrint::write(const uint8_t* data, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+    write(data[i]);
+  return len;
+}
+
+void CobsPrint::end()
+{
+  _out.write((uint8_t)(_used + 1));
+  _out.write(_block, _used);
+  _used = 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_SERIAL_FRAMER_H
+#define YARR_SERIAL_FRAMER_H
+
+#include "YarrboardConfig.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+typedef enum {
+  YB_SERIAL_FRAMING_LINE, // one json message per line, what you'd type in a terminal
+  YB_SERIAL_FRAMING_COBS  // COBS encoded, 0x00 delimited.  binary safe, and easy to pick out of log output
+} YBSerialFraming;
+
+/**
+ * SerialFramer
+ * Non blocking reader for framed protocol messages on a serial port.
+ *
+ * - poll() reads whatever bytes have arrived and returns true once a whole frame is in the buffer.
+ *   partial frames just sit there until the next call, nothing ever waits on the port.
+ * - frames bigger than YB_SERIAL_RX_BUFFER_SIZE are thrown away up to the next delimiter.
+ * - in COBS mode every outgoing frame starts and ends with 0x00, so the host can resync
+ *   past any log text that was printed in between.
+ */
+class SerialFramer
+{
+  public:
+    SerialFramer(Stream& port) : _port(port) {}
+
+    // takes effect at the next frame boundary, anything already buffered is kept
+    void setFraming(YBSerialFraming framing) { _framing = framing; }
+    YBSerialFraming getFraming() const { return _framing; }
+
+    bool poll();
+
+    // the decoded frame from the last successful poll(), valid until consume()
+    const char* frame() const { return (const char*)_rx; }
+    size_t frameLength() const { return _frameLen; }
+    void consume();
+
+    void writeFrame(JsonVariantConst doc, bool msgpack = false);
+    void writeFrame(const char* data, size_t len);
+
+    uint32_t frames = 0;
+    uint32_t overflows = 0;
+    uint32_t errors = 0; // bad COBS encoding
+
+    // payload bytes written, before COBS and delimiters
+    uint32_t bytesJson = 0;
+    uint32_t bytesMsgPack = 0;
+
+    static bool cobsDecode(uint8_t* data, size_t len, size_t& decodedLen);
+
+  private:
+    Stream& _port;
+    YBSerialFraming _framing = YB_SERIAL_FRAMING_LINE;
+
+    // bytes carry over from one poll() to the next
+    uint8_t _rx[YB_SERIAL_RX_BUFFER_SIZE + 1];
+    size_t _used = 0;
+    size_t _scanned = 0;
+    size_t _frameLen = 0;
+    size_t _frameEnd = 0; // where the next frame starts, once this one is consumed
+    bool _ready = false;
+    bool _discarding = false;
+
+    uint8_t _delimiter() const { return _framing == YB_SERIAL_FRAMING_COBS ? 0x00 : '\n'; }
+    bool _extractFrame();
+};
+
+// COBS encodes whatever is printed to it, 254 bytes at a time
+class CobsPrint : public Print
+{
+  public:
+    CobsPrint(Print& out) : _out(out) {}
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t len) override;
+
+    // writes the final block, without the trailing 0x00 delimiter
+    void end();
+
+  private:
+    Print& _out;
+    uint8_t _block[254];
+    uint8_t _used = 0;
+};
+
+#endif /* !YARR_SERIAL_FRAMER_H */
@@ -0,0 +1,76 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_TOKEN_BUCKET_H
+#define YARR_TOKEN_BUCKET_H
+
+#include <Arduino.h>
+
+/**
+ * TokenBucket
+ * Refills at `rate` tokens per second, holds at most `burst` of them.
+ *
+ * - tokens are kept in thousandths, so slow rates still refill every millisecond.
+ * - it starts out full, and a rate of 0 means unlimited.
+ * - not thread safe, the owner does the locking.
+ */
+class TokenBucket
+{
+  public:
+    bool has(uint32_t cost, uint32_t now_ms)
+    {
+      if (_rate == 0)
+        return true;
+
+      _refill(now_ms);
+      return _milli >= cost * 1000;
+    }
+
+    // call has() first, this doesn't check
+    void take(uint32_t cost)
+    {
+      if (_rate == 0)
+        return;
+
+      _milli = _milli > cost * 1000 ? _milli - cost * 1000 : 0;
+    }
+
+    void configure(uint32_t rate, uint32_t burst)
+    {
+      _rate = rate;
+      _burst = burst ? burst : rate;
+      if (_milli > _burst * 1000 || !_started)
+        _milli = _burst * 1000;
+      _started = true;
+    }
+
+    uint32_t tokens() const { return _milli / 1000; }
+
+  private:
+    void _refill(uint32_t now_ms)
+    {
+      uint32_t elapsed = now_ms - _last;
+      _last = now_ms;
+
+      // cap it so a long quiet spell can't overflow
+      uint64_t milli = _milli + (uint64_t)min(elapsed, (uint32_t)3600000) * _rate;
+      _milli = milli > _burst * 1000 ? _burst * 1000 : milli;
+    }
+
+    uint32_t _rate = 0;
+    uint32_t _burst = 0;
+    uint32_t _milli = 0;
+    uint32_t _last = 0;
+    bool _started = false;
+};
+
+#endif /* !YARR_TOKEN_BUCKET_H */
@@ -0,0 +1,57 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_UPDATE_SNAPSHOT_H
+#define YARR_UPDATE_SNAPSHOT_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <new>
+
+/**
+ * UpdateSnapshot
+ * One generated update message, shared by every transport that asks for it
+ * within YB_UPDATE_SNAPSHOT_MAX_AGE_MS of it being built.
+ *
+ * - it is never modified once it has been handed out, so readers need no lock.
+ * - the protocol controller holds one reference to the current snapshot, each
+ *   reader holds another until it calls release().
+ * - the last release() frees it, from whichever task that happens on.
+ */
+class UpdateSnapshot
+{
+  public:
+    static UpdateSnapshot* create() { return new (std::nothrow) UpdateSnapshot(); }
+
+    void retain() { _refs.fetch_add(1, std::memory_order_relaxed); }
+
+    void release()
+    {
+      if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete this;
+    }
+
+    JsonObjectConst state() const { return doc.as<JsonObjectConst>(); }
+
+    JsonDocument doc;
+    uint32_t version = 0; // from the DeltaTracker
+    int64_t built_us = 0; // esp_timer_get_time() when it was built
+
+  private:
+    UpdateSnapshot() : _refs(1) {}
+    ~UpdateSnapshot() = default;
+
+    std::atomic<uint16_t> _refs;
+};
+
+#endif /* !YARR_UPDATE_SNAPSHOT_H */
@@ -12,6 +12,9 @@
 
 #include "YarrboardApp.h"
 #include "YarrboardDebug.h"
+#include "channels/BaseChannel.h"
+#include <algorithm>
+#include <esp_timer.h>
 
 YarrboardApp::YarrboardApp() : config(*this),
                                debug(*this),
@@ -23,9 +26,7 @@ YarrboardApp::YarrboardApp() : config(*this),
                                ota(*this),
                                ntp(*this),
                                networkLogger(protocol),
-                               loopSpeed(100, 1000),
                                framerateAvg(10, 10000)
-
 {
   registerController(debug, 10);
   registerController(config, 20);
@@ -40,13 +41,21 @@ YarrboardApp::YarrboardApp() : config(*this),
 
 void YarrboardApp::setup()
 {
+  // who are we?  so other tasks can find / wake us up.
+  _loopTask = xTaskGetCurrentTaskHandle();
+  events.setConsumer(_loopTask);
+
+  _recordBootEvent("setup_start", micros());
+
+  // everyone is waiting to start
   for (const ControllerEntry& entry : _controllers) {
-    if (entry.controller->start())
-      YBP.printf("✅ %s setup OK\n", entry.controller->getName());
-    else
-      YBP.printf("❌ %s setup FAILED\n", entry.controller->getName());
+    entry.controller->_startPending = true;
+    _pendingStarts++;
   }
 
+  // start whoever we can.  network controllers will start later from loop()
+  _startPendingControllers();
+
   // we're done with startup log
   YBP.removePrinter(startupLogger);
 
@@ -55,7 +64,219 @@ void YarrboardApp::setup()
   // network logger is a troublemaker
   YBP.addPrinter(networkLogger);
 
-  lastLoopMicros = micros();
+#if !ARDUINO_USB_CDC_ON_BOOT
+  // incoming serial data should wake us up too.
+  if (enable_idle_sleep)
+    Serial.onReceive([this]() { wakeLoop(); });
+#endif
+
+  // so do channel changes, or the fast update waits out the rest of the sleep
+  if (enable_idle_sleep)
+    FastUpdateFlag::onRaised = etl::delegate<void()>::create<YarrboardApp, &YarrboardApp::wakeLoop>(*this);
+
+  _loopStatsMicros = micros();
+}
+
+bool YarrboardApp::_startDependenciesMet(BaseController* controller)
+{
+  uint8_t deps = controller->getStartDependencies();
+
+  if ((deps & YB_NEEDS_CONFIG) && config._startPending)
+    return false;
+
+  if ((deps & YB_NEEDS_NETWORK) && !network.isReady())
+    return false;
+
+  return true;
+}
+
+void YarrboardApp::_startPendingControllers()
+{
+  if (!_networkReadyLogged && network.isReady()) {
+    _recordBootEvent("network_ready", micros());
+    _networkReadyLogged = true;
+  }
+
+  // keep going until nobody else can start.  in order, so config still beats everyone.
+  bool progress = true;
+  while (progress && _pendingStarts) {
+    progress = false;
+    for (const ControllerEntry& entry : _controllers) {
+      BaseController* c = entry.controller;
+      if (!c->_startPending || !_startDependenciesMet(c))
+        continue;
+
+      _startController(c);
+      progress = true;
+    }
+  }
+
+  if (!_pendingStarts && !_bootCompleteMicros) {
+    _bootCompleteMicros = micros();
+    _recordBootEvent("boot_complete", _bootCompleteMicros);
+    _printBootTimeline();
+  }
+}
+
+void YarrboardApp::_recordBootEvent(const char* name, uint32_t start_us, bool ok)
+{
+  if (_bootTimeline.full())
+    return;
+
+  BootEvent e;
+  e.name = name;
+  e.start_us = start_us;
+  e.duration_us = micros() - start_us;
+  e.ok = ok;
+  _bootTimeline.push_back(e);
+}
+
+void YarrboardApp::_printBootTimeline()
+{
+  YBP.println("Boot timeline:");
+  for (const BootEvent& e : _bootTimeline)
+    YBP.printf("  %s %10lu us %8lu us  %s\n", e.ok ? "✅" : "❌", e.start_us, e.duration_us, e.name);
+}
+
+bool YarrboardApp::_startController(BaseController* controller)
+{
+  // we're done waiting, one way or another.
+  if (controller->_startPending) {
+    controller->_startPending = false;
+    _pendingStarts--;
+  }
+
+  uint32_t start_us = micros();
+  bool ok = controller->start();
+  _recordBootEvent(controller->getName(), start_us, ok);
+
+  // start() may have changed our loop() setup
+  _scheduleDirty = true;
+
+  if (!ok) {
+    YBP.printf("❌ %s setup FAILED\n", controller->getName());
+    return false;
+  }
+
+  YBP.printf("✅ %s setup OK (%lu us)\n", controller->getName(), micros() - start_us);
+
+  // does it get its own task?
+  if (controller->_exec.mode == YB_EXEC_TASK) {
+    if (!_startControllerTask(controller)) {
+      YBP.printf("❌ %s task FAILED\n", controller->getName());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool YarrboardApp::_startControllerTask(BaseController* controller)
+{
+  // already running?
+  if (_findTaskByController(controller) != nullptr)
+    return true;
+
+  // reuse a slot from a removed controller, entries never move while other tasks are looking them up
+  TaskEntry* t = _findTaskByController(nullptr);
+  if (t == nullptr) {
+    if (_tasks.full())
+      return false;
+    _tasks.push_back(TaskEntry());
+    t = &_tasks.back();
+  }
+
+  // single core chips only have core 0
+  const ExecutionPolicy& exec = controller->_exec;
+  BaseType_t core = exec.core;
+  if (core != tskNO_AFFINITY && (core < 0 || core >= portNUM_PROCESSORS))
+    core = tskNO_AFFINITY;
+
+  // queue goes in before the task starts so it can use it right away.
+  t->queue = new MainLoopQueue();
+  t->control = new TaskControl();
+  t->control->controller = controller;
+  t->controller = controller;
+
+  if (xTaskCreatePinnedToCore(_controllerTask, controller->getName(), exec.stackSize, t->control, exec.priority, &t->task, core) != pdPASS) {
+    delete t->queue;
+    delete t->control;
+    *t = TaskEntry();
+    return false;
+  }
+
+  return true;
+}
+
+bool YarrboardApp::_stopControllerTask(BaseController* controller)
+{
+  TaskEntry* t = _findTaskByController(controller);
+  if (t == nullptr)
+    return true;
+
+  // it can't wait on itself
+  if (t->task == xTaskGetCurrentTaskHandle())
+    return false;
+
+  // it won't start another loop(), wait for the one it's in
+  t->control->stop = true;
+  uint32_t start = millis();
+  while (t->control->busy) {
+    if (millis() - start >= YB_TASK_STOP_TIMEOUT_MS) {
+      YBP.printf("%s task is still in loop(), not removed\n", controller->getName());
+      return false;
+    }
+    vTaskDelay(1);
+  }
+
+  vTaskDelete(t->task);
+
+  // deliver whatever it finished before we stopped it
+  MainLoopCall call;
+  while (t->queue->pop(call)) {
+    if (call.message != nullptr) {
+      protocol.sendToAll(call.message, call.role);
+      free(call.message);
+    } else if (call.callback.is_valid())
+      call.callback();
+  }
+
+  delete t->queue;
+  delete t->control;
+  *t = TaskEntry();
+
+  return true;
+}
+
+void YarrboardApp::_controllerTask(void* pv)
+{
+  TaskControl* control = static_cast<TaskControl*>(pv);
+  BaseController* controller = control->controller;
+  TickType_t lastWake = xTaskGetTickCount();
+
+  for (;;) {
+    // busy goes up before we look at stop, so _stopControllerTask() either sees us
+    // busy and waits, or we see stop and never call loop() again.
+    control->busy = true;
+    if (control->stop) {
+      control->busy = false;
+      vTaskSuspend(NULL); // deleted by the main loop
+    }
+
+    uint32_t start = micros();
+    controller->loop();
+    _accountLoop(controller, start);
+    control->busy = false;
+
+    // periodic controllers keep a steady beat, the rest just yield a tick.
+    TickType_t interval = pdMS_TO_TICKS(controller->getLoopInterval());
+    if (interval)
+      vTaskDelayUntil(&lastWake, interval);
+    else {
+      vTaskDelay(1);
+      lastWake = xTaskGetTickCount();
+    }
+  }
 }
 
 void YarrboardApp::_handleImprov()
@@ -78,13 +299,10 @@ void YarrboardApp::_handleImprov()
 
     YBP.println("Re-starting failed controllers.");
     for (const ControllerEntry& entry : _controllers) {
-      if (!entry.controller->isStarted()) {
-        if (entry.controller->start())
-          YBP.printf("✅ %s setup OK\n", entry.controller->getName());
-        else
-          YBP.printf("❌ %s setup FAILED\n", entry.controller->getName());
-      }
+      if (!entry.controller->isStarted())
+        _startController(entry.controller);
     }
+    _startPendingControllers();
 
     // we're totally done now.
     network.improvDone = false;
@@ -100,46 +318,323 @@ void YarrboardApp::loop()
     return;
   }
 
+  // what time is it?
+  _tick(esp_timer_get_time());
+
+  // anyone still waiting on the network?
+  if (_pendingStarts)
+    _startPendingControllers();
+
   // start our interval timer
-  debug.it.start();
+  debug.it.start(_frame.now_us);
+
+  _runControllers(_frame.now_ms);
+
+  // how hard are we working?
+  _updateLoopStats(_frame.now_us);
+
+  // nothing left to do?  sleep until we're woken up or a deadline is due.
+  if (enable_idle_sleep)
+    _idleSleep(millis());
+}
+
+void YarrboardApp::_tick(int64_t now_us)
+{
+  uint32_t us = (uint32_t)now_us;
+
+  // same math as micros() and millis()
+  _frame.dt_us = _frame.count ? us - _frame.now_us : 0;
+  _frame.now_us = us;
+  _frame.now_ms = (uint32_t)(now_us / 1000);
+  _frame.count++;
+}
+
+void YarrboardApp::_updateLoopStats(uint32_t loopStartMicros)
+{
+  uint32_t now = micros();
+
+  _loopWakeupCount++;
+  totalLoopWakeups++;
+  _loopBusyMicros += now - loopStartMicros;
+
+  // update our stats every second
+  uint32_t elapsed = now - _loopStatsMicros;
+  if (elapsed >= 1000000) {
+    loopWakeups = _loopWakeupCount;
+    loopUtilization = 100.0 * _loopBusyMicros / elapsed;
+
+    framerateAvg.add(_loopWakeupCount, _frame.now_ms);
+    framerate = framerateAvg.average(_frame.now_ms, true);
+
+    _loopWakeupCount = 0;
+    _loopBusyMicros = 0;
+    _loopStatsMicros = now;
+  }
+}
+
+void YarrboardApp::_idleSleep(uint32_t now)
+{
+  // schedule changed, go around again.
+  if (_scheduleDirty)
+    return;
+
+  // controllers that poll every pass still need a regular kick.
+  uint32_t sleep_ms = YB_IDLE_MAX_SLEEP_MS;
+
+  // wake up in time for the next controller deadline
+  if (!_timerHeap.empty()) {
+    int32_t until = (int32_t)(_timerHeap.front()->getNextLoopMillis() - now);
+    if (until <= 0)
+      return;
+    if ((uint32_t)until < sleep_ms)
+      sleep_ms = until;
+  }
+
+  // block until notified or we time out.
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleep_ms));
+}
+
+void YarrboardApp::wakeLoop()
+{
+  if (_loopTask == nullptr)
+    return;
+
+  // channel setters can run from an interrupt
+  if (xPortInIsrContext()) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(_loopTask, &woken);
+    if (woken)
+      portYIELD_FROM_ISR();
+  } else
+    xTaskNotifyGive(_loopTask);
+}
+
+void YarrboardApp::_rebuildSchedule()
+{
+  _pollControllers.clear();
+  _timerHeap.clear();
 
   for (const ControllerEntry& entry : _controllers) {
-    entry.controller->loop();
-    debug.it.time(entry.controller->getName());
+    // task controllers run themselves
+    if (entry.controller->_exec.mode == YB_EXEC_TASK)
+      continue;
+
+    // no loop() until setup() has had its chance
+    if (entry.controller->_startPending)
+      continue;
+
+    if (entry.controller->getLoopInterval())
+      _timerHeap.push(entry.controller);
+    else
+      _pollControllers.push_back(entry.controller);
+  }
+
+  _scheduleDirty = false;
+}
+
+void YarrboardApp::_runControllers(uint32_t now)
+{
+  if (_scheduleDirty)
+    _rebuildSchedule();
+
+  // anything our controller tasks handed off to us?
+  _drainTaskQueues();
+
+  // let everyone know what happened since last time
+  events.dispatch();
+
+  uint32_t frameStartMicros = micros();
+
+  // these guys want every single pass.
+  for (BaseController* c : _pollControllers) {
+    _runController(c, frameStartMicros);
+  }
+
+  // now anyone whose deadline has passed.  controllers that aren't due yet cost nothing.
+  while (!_scheduleDirty && _timerHeap.due(now)) {
+    BaseController* c = _timerHeap.pop();
+    c->_rescheduled = false;
+
+    bool ran = _runController(c, frameStartMicros);
+
+    // deferred, try again on the next pass
+    if (!ran)
+      c->_nextLoopMillis = now + 1;
+    // a setNextLoop() from inside loop() wins over the regular interval
+    else if (!c->_rescheduled)
+      c->_nextLoopMillis = ControllerHeap::advance(c->_nextLoopMillis, c->_loopInterval, now);
+
+    _timerHeap.push(c);
   }
 
-  // calculate our framerate
-  unsigned long loopDelta = micros() - lastLoopMicros;
-  lastLoopMicros = micros();
-  loopSpeed.add(loopDelta);
-  unsigned long framerate_now = 1000000 / loopSpeed.average();
+  if (frame_budget_us && micros() - frameStartMicros > frame_budget_us)
+    frameOverruns++;
+}
+
+// false if the controller was deferred because we're over our frame budget
+bool YarrboardApp::_runController(BaseController* c, uint32_t frameStartMicros)
+{
+  uint32_t start = micros();
 
-  // smooth out our frequency
-  if (millis() - lastLoopMillis > 1000) {
-    framerateAvg.add(framerate_now);
-    framerate = framerateAvg.average();
-    lastLoopMillis = millis();
+  if (frame_budget_us && c->_loopPriority == YB_LOOP_PRIORITY_LOW && start - frameStartMicros > frame_budget_us) {
+    c->_deferredLoops++;
+    return false;
   }
+
+  c->loop();
+  uint32_t end = _accountLoop(c, start);
+  debug.it.time(c->getName(), end);
+
+  return true;
+}
+
+// returns the end time, so callers don't have to read the clock again
+uint32_t YarrboardApp::_accountLoop(BaseController* c, uint32_t startMicros)
+{
+  uint32_t end = micros();
+  uint32_t elapsed = end - startMicros;
+
+  c->_lastLoopMicros = elapsed;
+  if (elapsed > c->_worstLoopMicros) {
+    c->_worstLoopMicros = elapsed;
+    c->_worstLoopMillis = millis();
+  }
+
+  if (c->_loopBudget && elapsed > c->_loopBudget)
+    c->_budgetOverruns++;
+
+  return end;
+}
+
+YarrboardApp::TaskEntry* YarrboardApp::_findTask(TaskHandle_t task)
+{
+  for (TaskEntry& t : _tasks) {
+    if (t.task == task)
+      return &t;
+  }
+  return nullptr;
+}
+
+YarrboardApp::TaskEntry* YarrboardApp::_findTaskByController(BaseController* controller)
+{
+  for (TaskEntry& t : _tasks) {
+    if (t.controller == controller)
+      return &t;
+  }
+  return nullptr;
+}
+
+void YarrboardApp::_drainTaskQueues()
+{
+  MainLoopCall call;
+
+  for (TaskEntry& t : _tasks) {
+    if (t.queue == nullptr)
+      continue;
+
+    while (t.queue->pop(call)) {
+      if (call.message != nullptr) {
+        protocol.sendToAll(call.message, call.role);
+        free(call.message);
+      } else if (call.callback.is_valid())
+        call.callback();
+    }
+  }
+}
+
+bool YarrboardApp::runOnMainLoop(etl::delegate<void(void)> callback)
+{
+  // not from a controller task?  just do it.
+  TaskEntry* t = _findTask(xTaskGetCurrentTaskHandle());
+  if (t == nullptr) {
+    callback();
+    return true;
+  }
+
+  MainLoopCall call;
+  call.callback = callback;
+  if (!t->queue->push(call))
+    return false;
+
+  wakeLoop();
+  return true;
+}
+
+bool YarrboardApp::queueMessageForMainLoop(const char* jsonString, UserRole auth_level)
+{
+  TaskEntry* t = _findTask(xTaskGetCurrentTaskHandle());
+  if (t == nullptr)
+    return false;
+
+  MainLoopCall call;
+  call.message = strdup(jsonString);
+  call.role = auth_level;
+
+  return _pushMessage(t, call);
+}
+
+bool YarrboardApp::queueMessageForMainLoop(JsonVariantConst doc, UserRole auth_level)
+{
+  TaskEntry* t = _findTask(xTaskGetCurrentTaskHandle());
+  if (t == nullptr)
+    return false;
+
+  // the queue needs its own copy, so this is the one place we still need a full buffer
+  size_t jsonSize = measureJson(doc);
+
+  MainLoopCall call;
+  call.message = (char*)malloc(jsonSize + 1);
+  call.role = auth_level;
+  if (call.message != nullptr)
+    serializeJson(doc, call.message, jsonSize + 1);
+
+  return _pushMessage(t, call);
+}
+
+bool YarrboardApp::_pushMessage(TaskEntry* t, MainLoopCall& call)
+{
+  if (call.message == nullptr || !t->queue->push(call)) {
+    // dont use YBP here because it will get recursive.
+    Serial.printf("%s main loop queue full\n", t->controller->getName());
+    free(call.message);
+  } else
+    wakeLoop();
+
+  return true;
+}
+
+void YarrboardApp::rescheduleController(BaseController& controller)
+{
+  // so _runControllers() doesn't stomp on a deadline set from inside loop()
+  controller._rescheduled = true;
+
+  // cheap enough to just rebuild it on the next pass.
+  _scheduleDirty = true;
 }
 
 // Register a controller instance (non-owning).
-// Returns false if full or name duplicate.
+// Returns the handle slot, or -1 if full or name duplicate.
 // Controllers are sorted by order (lower values run first).
-bool YarrboardApp::registerController(BaseController& controller, uint8_t order)
+int YarrboardApp::_registerController(BaseController& controller, uint8_t order)
 {
   const char* n = controller.getName();
   if (!n || !*n)
-    return false;
+    return -1;
 
   if (getController(n) != nullptr) {
     // duplicate name
-    return false;
+    return -1;
   }
 
   if (_controllers.full()) {
-    return false;
+    return -1;
   }
 
+  // grab a free slot for our handle
+  int slot = _slots.add(&controller);
+  if (slot < 0)
+    return -1;
+
   // Create new entry
   ControllerEntry entry(&controller, order);
 
@@ -151,7 +646,64 @@ bool YarrboardApp::registerController(BaseController& controller, uint8_t order)
 
   // Insert at the correct position
   _controllers.insert(it, entry);
-  return true;
+  controller._registered = true;
+  _scheduleDirty = true;
+
+  // hooks can be called during setup(), so update these right away
+  _rebuildHooks();
+
+  return slot;
+}
+
+void YarrboardApp::_rebuildHooks()
+{
+  for (HookList& list : _hookSubscribers)
+    list.clear();
+
+  for (const ControllerEntry& entry : _controllers) {
+    for (uint8_t hook = 0; hook < YB_HOOK_COUNT; hook++) {
+      if (entry.controller->hasHook((YBHook)hook))
+        _hookSubscribers[hook].push_back(entry.controller);
+    }
+  }
+}
+
+const char* YarrboardApp::getHookName(YBHook hook)
+{
+  switch (hook) {
+    case YB_HOOK_LOAD_CONFIG:
+      return "load_config";
+    case YB_HOOK_CONFIG:
+      return "config";
+    case YB_HOOK_CAPABILITIES:
+      return "capabilities";
+    case YB_HOOK_UPDATE:
+      return "update";
+    case YB_HOOK_FAST_UPDATE:
+      return "fast_update";
+    case YB_HOOK_STATS:
+      return "stats";
+    case YB_HOOK_MQTT_UPDATE:
+      return "mqtt_update";
+    case YB_HOOK_HA_UPDATE:
+      return "ha_update";
+    case YB_HOOK_HA_DISCOVERY:
+      return "ha_discovery";
+    case YB_HOOK_BRIGHTNESS:
+      return "brightness";
+    default:
+      return "unknown";
+  }
+}
+
+void YarrboardApp::_attachController(RGBControllerInterface* controller, uint8_t slot)
+{
+  _rgb = _slots.handle<RGBControllerInterface>(slot);
+}
+
+void YarrboardApp::_attachController(BuzzerController* controller, uint8_t slot)
+{
+  _buzzer = _slots.handle<BuzzerController>(slot);
 }
 
 // Lookup by name (nullptr if not found)
@@ -182,7 +734,24 @@ bool YarrboardApp::removeController(const char* name)
   for (size_t i = 0; i < _controllers.size(); i++) {
     const ControllerEntry& entry = _controllers[i];
     if (entry.controller && entry.controller->getName() && (std::strcmp(entry.controller->getName(), name) == 0)) {
+      // its task has to be gone before anything else goes
+      if (!_stopControllerTask(entry.controller))
+        return false;
+
+      entry.controller->_registered = false;
+
+      // don't wait on it to start either
+      if (entry.controller->_startPending) {
+        entry.controller->_startPending = false;
+        _pendingStarts--;
+      }
+
+      // invalidate any outstanding handles
+      _slots.remove(entry.controller);
+
       _controllers.erase(_controllers.begin() + i);
+      _scheduleDirty = true;
+      _rebuildHooks();
       return true;
     }
   }
@@ -191,21 +760,21 @@ bool YarrboardApp::removeController(const char* name)
 
 void YarrboardApp::setStatusColor(uint8_t r, uint8_t g, uint8_t b)
 {
-  RGBControllerInterface* rgb = (RGBControllerInterface*)getController("rgb");
+  RGBControllerInterface* rgb = getController(_rgb);
   if (rgb)
     rgb->setStatusColor(r, g, b);
 }
 
 void YarrboardApp::setStatusColor(const CRGB& color)
 {
-  RGBControllerInterface* rgb = (RGBControllerInterface*)getController("rgb");
+  RGBControllerInterface* rgb = getController(_rgb);
   if (rgb)
     rgb->setStatusColor(color);
 }
 
 void YarrboardApp::playMelody(const char* melody)
 {
-  BuzzerController* buzzer = (BuzzerController*)getController("buzzer");
+  BuzzerController* buzzer = getController(_buzzer);
   if (buzzer)
     buzzer->playMelodyByName(melody);
 }
\ No newline at end of file
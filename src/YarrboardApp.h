@@ -14,6 +14,10 @@
 #define YarrboardApp_h
 
 #include "ConfigManager.h"
+#include "ControllerHandle.h"
+#include "DeadlineHeap.h"
+#include "EventBus.h"
+#include "HookTraits.h"
 #include "IntervalTimer.h"
 #include "RollingAverage.h"
 #include "YarrboardDebug.h"
@@ -29,8 +33,13 @@
 #include "controllers/ProtocolController.h"
 #include "controllers/RGBController.h"
 
+#include <atomic>
 #include <cstring>         // For strcmp
+#include <type_traits>
 #include <etl/algorithm.h> // For finding/removing
+#include <etl/array.h>
+#include <etl/delegate.h>
+#include <etl/queue_spsc_atomic.h>
 #include <etl/vector.h>
 
 class YarrboardApp
@@ -46,7 +55,50 @@ class YarrboardApp
         bool operator<(const ControllerEntry& other) const { return order < other.order; }
     };
 
+    // a call handed off from a controller task to the main loop
+    struct MainLoopCall {
+        etl::delegate<void(void)> callback;
+        char* message = nullptr;
+        UserRole role = NOBODY;
+    };
+
+    // each controller task is the single producer for its own queue, the main loop is the consumer.
+    typedef etl::queue_spsc_atomic<MainLoopCall, YB_TASK_QUEUE_SIZE> MainLoopQueue;
+
+    // shared by a controller task and the main loop, so removeController() can stop it cleanly
+    struct TaskControl {
+        BaseController* controller = nullptr;
+        std::atomic<bool> stop{false};
+        std::atomic<bool> busy{false}; // inside loop(), not safe to delete
+    };
+
+    // a free slot has no task
+    struct TaskEntry {
+        BaseController* controller = nullptr;
+        TaskHandle_t task = nullptr;
+        MainLoopQueue* queue = nullptr;
+        TaskControl* control = nullptr;
+    };
+
+    // the clock, read once per pass of the main loop
+    struct FrameClock {
+        uint32_t now_us = 0;
+        uint32_t now_ms = 0;
+        uint32_t dt_us = 0; // since the previous pass
+        uint32_t count = 0;
+    };
+
+    // one step of the boot process, micros() since power on
+    struct BootEvent {
+        const char* name = nullptr;
+        uint32_t start_us = 0;
+        uint32_t duration_us = 0;
+        bool ok = true;
+    };
+    typedef etl::vector<BootEvent, YB_BOOT_TIMELINE_SIZE> BootTimeline;
+
     ConfigManager config;
+    EventBus events;
     DebugController debug;
     NetworkController network;
     HTTPController http;
@@ -84,6 +136,12 @@ class YarrboardApp
     bool enable_ha_integration = false;
     bool use_hostname_as_mqtt_uuid = true;
 
+    // sleep the main loop between events instead of spinning
+    bool enable_idle_sleep = false;
+
+    // once a pass has used this many micros, low priority controllers wait for the next pass.  0 = off
+    uint32_t frame_budget_us = 0;
+
     UserRole default_role = NOBODY;
     const char* default_melody = "STARTUP";
 
@@ -92,14 +150,67 @@ class YarrboardApp
     void setup();
     void loop();
 
-    unsigned int framerate;
+    // time at the start of this main loop pass.  cheaper than millis()/micros()
+    // and the same for every controller in the pass.  main loop only.
+    const FrameClock& frame() const { return _frame; }
+
+    // main loop passes per second, averaged over the last 10 seconds
+    unsigned int framerate = 0;
+
+    // main loop stats, updated every second
+    unsigned int loopWakeups = 0;
+    unsigned long totalLoopWakeups = 0;
+    float loopUtilization = 0;
 
-    static constexpr size_t MAX_CONTROLLERS = 16;
+    // how did our boot go?  boot is complete once every deferred controller has started.
+    const BootTimeline& getBootTimeline() const { return _bootTimeline; }
+    bool isBootComplete() { return _pendingStarts == 0; }
+    uint32_t getBootCompleteMicros() { return _bootCompleteMicros; }
+
+    // passes that went over frame_budget_us
+    uint32_t frameOverruns = 0;
 
     // Register a controller instance (non-owning).
-    // Returns false if full or name duplicate.
+    // Returns an invalid handle if full or name duplicate.
     // Controllers are sorted by order (lower values run first).
-    bool registerController(BaseController& controller, uint8_t order = 100);
+    // The policy decides if loop() runs in the main loop or its own task.
+    template <typename T>
+    ControllerHandle<T> registerController(T& controller, uint8_t order = 100)
+    {
+      static_assert(std::is_base_of<BaseController, T>::value, "T must derive from BaseController");
+
+      // which hooks does it actually implement?
+      controller._hooks = controller.subscribeHooks(_detectHooks<T>()) & YB_ALL_HOOKS;
+
+      int slot = _registerController(controller, order);
+      if (slot < 0)
+        return ControllerHandle<T>();
+
+      // hook up the controllers we talk to directly.
+      _attachController(&controller, slot);
+
+      return _slots.handle<T>(slot);
+    }
+
+    template <typename T>
+    ControllerHandle<T> registerController(T& controller, uint8_t order, const ExecutionPolicy& policy)
+    {
+      controller._exec = policy;
+      return registerController(controller, order);
+    }
+
+    // Lookup by handle (nullptr if it was removed)
+    template <typename T>
+    T* getController(ControllerHandle<T> handle)
+    {
+      return _slots.get(handle);
+    }
+
+    // Controllers that override a given hook, in controller order.
+    // Hot paths should walk this instead of every controller.
+    typedef etl::vector<BaseController*, YB_MAX_CONTROLLERS> HookList;
+    const HookList& getHookSubscribers(YBHook hook) const { return _hookSubscribers[hook]; }
+    static const char* getHookName(YBHook hook);
 
     // Lookup by name (nullptr if not found)
     BaseController* getController(const char* name);
@@ -109,9 +220,14 @@ class YarrboardApp
     // The vector itself is const (cannot resize), but the entries inside are mutable.
     const etl::vector<ControllerEntry, YB_MAX_CONTROLLERS>& getControllers() const { return _controllers; };
 
-    // Remove by name (returns true if removed)
+    // Remove by name (returns true if removed).  main loop only.
+    // a task controller's task is stopped first, once its current loop() returns.
+    // false if it didn't return within YB_TASK_STOP_TIMEOUT_MS, try again later.
     bool removeController(const char* name);
 
+    // Called when a controller changes its loop interval or next deadline.
+    void rescheduleController(BaseController& controller);
+
     ConfigManager& getConfig() { return config; }
     const ConfigManager& getConfig() const { return config; }
 
@@ -120,17 +236,114 @@ class YarrboardApp
 
     void playMelody(const char* melody);
 
+    // wake the main loop if its sleeping. safe to call from any task.
+    void wakeLoop();
+
+    // Run a callback on the main loop.  Called from a controller task it gets
+    // queued lock-free for the next pass, otherwise it runs immediately.
+    // Returns false if the queue was full.
+    bool runOnMainLoop(etl::delegate<void(void)> callback);
+
+    // Used by ProtocolController::sendToAll() to hand messages from controller tasks
+    // to the main loop.  Returns false if we're not on a controller task.
+    bool queueMessageForMainLoop(const char* jsonString, UserRole auth_level);
+    bool queueMessageForMainLoop(JsonVariantConst doc, UserRole auth_level);
+
   private:
     WebsocketPrint networkLogger;
 
-    // various timer things.
-    RollingAverage loopSpeed;
+    // idle mode + loop stats
+    TaskHandle_t _loopTask = nullptr;
     RollingAverage framerateAvg;
-    unsigned long lastLoopMicros = 0;
-    unsigned long lastLoopMillis = 0;
+    unsigned int _loopWakeupCount = 0;
+    uint32_t _loopBusyMicros = 0;
+    uint32_t _loopStatsMicros = 0;
 
     etl::vector<ControllerEntry, YB_MAX_CONTROLLERS> _controllers;
 
+    // stable storage for controller handles
+    HandleTable<BaseController, YB_MAX_CONTROLLERS> _slots;
+
+    // per-hook dispatch lists
+    etl::array<HookList, YB_HOOK_COUNT> _hookSubscribers;
+    void _rebuildHooks();
+
+    // a hook is overridden if T's version of it isn't the BaseController one.
+    // this only sees T, so if T can't be the real type (BaseController itself, or an
+    // abstract base) we can't tell what is overridden and subscribe to everything.
+    template <typename T>
+    static uint16_t _detectHooks()
+    {
+      if (std::is_same<T, BaseController>::value || std::is_abstract<T>::value)
+        return YB_ALL_HOOKS;
+
+#define YB_DETECT_HOOK(id, name) \
+  if (!std::is_same<YB_HOOK_OWNER(T, BaseController, name), BaseController>::value) \
+    hooks |= (1 << id);
+
+      uint16_t hooks = 0;
+      YB_DETECT_HOOK(YB_HOOK_LOAD_CONFIG, loadConfigHook);
+      YB_DETECT_HOOK(YB_HOOK_CONFIG, generateConfigHook);
+      YB_DETECT_HOOK(YB_HOOK_CAPABILITIES, generateCapabilitiesHook);
+      YB_DETECT_HOOK(YB_HOOK_UPDATE, generateUpdateHook);
+      YB_DETECT_HOOK(YB_HOOK_FAST_UPDATE, needsFastUpdate);
+      YB_DETECT_HOOK(YB_HOOK_FAST_UPDATE, generateFastUpdateHook);
+      YB_DETECT_HOOK(YB_HOOK_STATS, generateStatsHook);
+      YB_DETECT_HOOK(YB_HOOK_MQTT_UPDATE, mqttUpdateHook);
+      YB_DETECT_HOOK(YB_HOOK_HA_UPDATE, haUpdateHook);
+      YB_DETECT_HOOK(YB_HOOK_HA_DISCOVERY, haGenerateDiscoveryHook);
+      YB_DETECT_HOOK(YB_HOOK_BRIGHTNESS, updateBrightnessHook);
+      return hooks;
+
+#undef YB_DETECT_HOOK
+    }
+
+    ControllerHandle<RGBControllerInterface> _rgb;
+    ControllerHandle<BuzzerController> _buzzer;
+
+    int _registerController(BaseController& controller, uint8_t order);
+
+    // picks the most specific overload for the controller type at compile time
+    void _attachController(BaseController* controller, uint8_t slot) {}
+    void _attachController(RGBControllerInterface* controller, uint8_t slot);
+    void _attachController(BuzzerController* controller, uint8_t slot);
+
+    // loop() schedule: controllers that run every pass (in order),
+    // plus a min-heap of periodic controllers keyed on their next deadline.
+    etl::vector<BaseController*, YB_MAX_CONTROLLERS> _pollControllers;
+    typedef DeadlineHeap<BaseController, YB_MAX_CONTROLLERS> ControllerHeap;
+    ControllerHeap _timerHeap;
+    bool _scheduleDirty = true;
+
+    // controllers with their own task
+    etl::vector<TaskEntry, YB_MAX_TASK_CONTROLLERS> _tasks;
+
+    void _rebuildSchedule();
+    bool _startController(BaseController* controller);
+    bool _startDependenciesMet(BaseController* controller);
+    void _startPendingControllers();
+    void _recordBootEvent(const char* name, uint32_t start_us, bool ok = true);
+    void _printBootTimeline();
+
+    BootTimeline _bootTimeline;
+    uint8_t _pendingStarts = 0;
+    uint32_t _bootCompleteMicros = 0;
+    bool _networkReadyLogged = false;
+    bool _startControllerTask(BaseController* controller);
+    TaskEntry* _findTask(TaskHandle_t task);
+    TaskEntry* _findTaskByController(BaseController* controller);
+    bool _stopControllerTask(BaseController* controller);
+    bool _pushMessage(TaskEntry* t, MainLoopCall& call);
+    void _drainTaskQueues();
+    static void _controllerTask(void* pv);
+    FrameClock _frame;
+    void _tick(int64_t now_us);
+
+    void _runControllers(uint32_t now);
+    bool _runController(BaseController* c, uint32_t frameStartMicros);
+    static uint32_t _accountLoop(BaseController* c, uint32_t startMicros);
+    void _updateLoopStats(uint32_t loopStartMicros);
+    void _idleSleep(uint32_t now);
     void _handleImprov();
 };
 
@@ -51,9 +51,31 @@
     #define YB_CLIENT_LIMIT 13
   #endif
 
-  // for handling messages outside of the loop
+  // broadcasts a websocket client can have queued before it starts missing them
+  #ifndef YB_WEBSOCKET_MAX_INFLIGHT
+    #define YB_WEBSOCKET_MAX_INFLIGHT 8
+  #endif
+
+  // fixed buffers a streamed websocket reply goes out through, and how long to wait for one to free up
+  #ifndef YB_WEBSOCKET_FRAGMENT_BUFFERS
+    #define YB_WEBSOCKET_FRAGMENT_BUFFERS 2
+  #endif
+  #ifndef YB_WEBSOCKET_FRAGMENT_WAIT_MS
+    #define YB_WEBSOCKET_FRAGMENT_WAIT_MS 500
+  #endif
+
+  // for handling messages outside of the loop.  polls get the big queue, control commands their own.
   #define YB_RECEIVE_BUFFER_COUNT 100
 
+  #ifndef YB_RECEIVE_CONTROL_BUFFER_COUNT
+    #define YB_RECEIVE_CONTROL_BUFFER_COUNT 32
+  #endif
+
+  // max time spent on queued websocket messages per pass of the main loop, 0 = no limit
+  #ifndef YB_RECEIVE_DRAIN_BUDGET_US
+    #define YB_RECEIVE_DRAIN_BUDGET_US 5000
+  #endif
+
   // various string lengths
   #define YB_PREF_KEY_LENGTH      16
   #define YB_BOARD_NAME_LENGTH    32
@@ -68,6 +90,8 @@
   #define YB_HOSTNAME_LENGTH      64
   #define YB_MQTT_SERVER_LENGTH   128
   #define YB_ERROR_LENGTH         128
+  #define YB_PROTOCOL_MAX_COMMAND_LENGTH 32
+  #define YB_PROTOCOL_MAX_FIELD_LENGTH 64
   #define YB_UUID_LENGTH          17
   #define YB_BOARD_CONFIG_PATH    "/yarrboard.json"
 
@@ -108,4 +132,163 @@
     #define YB_PROTOCOL_MAX_COMMANDS 50
   #endif
 
+  // fields tracked for delta updates, power of 2.  fields past 3/4 full are always sent.
+  #ifndef YB_UPDATE_FIELD_TABLE_SIZE
+    #define YB_UPDATE_FIELD_TABLE_SIZE 512
+  #endif
+
+  // how old a shared update snapshot can be before the next reader builds a new one
+  #ifndef YB_UPDATE_SNAPSHOT_MAX_AGE_MS
+    #define YB_UPDATE_SNAPSHOT_MAX_AGE_MS 20
+  #endif
+
+  // chunk size for streaming json out to http, websockets and files
+  #ifndef YB_JSON_STREAM_BUFFER_SIZE
+    #define YB_JSON_STREAM_BUFFER_SIZE 512
+  #endif
+
+  // fast updates wait this long after the first change so others can merge in
+  #ifndef YB_FAST_UPDATE_WINDOW_MS
+    #define YB_FAST_UPDATE_WINDOW_MS 10
+  #endif
+
+  // max fast updates per second, 0 for no limit
+  #ifndef YB_FAST_UPDATE_MAX_RATE
+    #define YB_FAST_UPDATE_MAX_RATE 20
+  #endif
+
+  // update subscriptions per websocket client
+  #ifndef YB_PROTOCOL_MAX_SUBSCRIPTIONS
+    #define YB_PROTOCOL_MAX_SUBSCRIPTIONS 16
+  #endif
+
+  // most commands allowed in one batched frame
+  #ifndef YB_PROTOCOL_MAX_BATCH
+    #define YB_PROTOCOL_MAX_BATCH 16
+  #endif
+
+  // command lookup table, power of 2 and at least 2x YB_PROTOCOL_MAX_COMMANDS
+  #ifndef YB_PROTOCOL_HASH_SIZE
+    #define YB_PROTOCOL_HASH_SIZE 128
+  #endif
+
+  // token buckets for inbound commands, in command weight per second.  0 = unlimited
+  #ifndef YB_RATE_LIMIT_CLIENT_RATE
+    #define YB_RATE_LIMIT_CLIENT_RATE 20
+  #endif
+
+  #ifndef YB_RATE_LIMIT_CLIENT_BURST
+    #define YB_RATE_LIMIT_CLIENT_BURST 40
+  #endif
+
+  #ifndef YB_RATE_LIMIT_TRANSPORT_RATE
+    #define YB_RATE_LIMIT_TRANSPORT_RATE 100
+  #endif
+
+  #ifndef YB_RATE_LIMIT_TRANSPORT_BURST
+    #define YB_RATE_LIMIT_TRANSPORT_BURST 200
+  #endif
+
+  // how many clients get their own bucket, the least recently seen one is recycled
+  #ifndef YB_RATE_LIMIT_CLIENTS
+    #define YB_RATE_LIMIT_CLIENTS 16
+  #endif
+
+  // serial protocol: baud rate, the largest frame we accept, and how many we handle per loop pass
+  #ifndef YB_SERIAL_BAUD
+    #define YB_SERIAL_BAUD 115200
+  #endif
+
+  #ifndef YB_SERIAL_RX_BUFFER_SIZE
+    #define YB_SERIAL_RX_BUFFER_SIZE 1024
+  #endif
+
+  #ifndef YB_SERIAL_MAX_FRAMES_PER_LOOP
+    #define YB_SERIAL_MAX_FRAMES_PER_LOOP 4
+  #endif
+
+  // power of 2 latency buckets per command, the last one holds everything over 2^(n-2) us
+  #ifndef YB_LATENCY_HISTOGRAM_BUCKETS
+    #define YB_LATENCY_HISTOGRAM_BUCKETS 20
+  #endif
+
+  // replies a handler can put off at once, how long they get, and the stack for the worker task that runs them
+  #ifndef YB_PROTOCOL_MAX_DEFERRED
+    #define YB_PROTOCOL_MAX_DEFERRED 4
+  #endif
+
+  #ifndef YB_PROTOCOL_DEFERRED_TIMEOUT_MS
+    #define YB_PROTOCOL_DEFERRED_TIMEOUT_MS 60000
+  #endif
+
+  // longest an http request holds the server task waiting on a deferred reply, then it gets the token
+  #ifndef YB_PROTOCOL_HTTP_WAIT_MS
+    #define YB_PROTOCOL_HTTP_WAIT_MS 2000
+  #endif
+
+  #ifndef YB_PROTOCOL_DEFERRED_STACK_SIZE
+    #define YB_PROTOCOL_DEFERRED_STACK_SIZE 10240
+  #endif
+
+  // bytes of storage for a command handler (instance + member function pointer)
+  #ifndef YB_PROTOCOL_HANDLER_SIZE
+    #define YB_PROTOCOL_HANDLER_SIZE (4 * sizeof(void*))
+  #endif
+
+  // controllers running in their own FreeRTOS task
+  #ifndef YB_MAX_TASK_CONTROLLERS
+    #define YB_MAX_TASK_CONTROLLERS 4
+  #endif
+
+  // how long removeController() waits for a task controller's loop() to return
+  #ifndef YB_TASK_STOP_TIMEOUT_MS
+    #define YB_TASK_STOP_TIMEOUT_MS 1000
+  #endif
+
+  // queued calls from a controller task back to the main loop
+  #ifndef YB_TASK_QUEUE_SIZE
+    #define YB_TASK_QUEUE_SIZE 16
+  #endif
+
+  // longest the main loop will sleep in idle mode
+  #ifndef YB_IDLE_MAX_SLEEP_MS
+    #define YB_IDLE_MAX_SLEEP_MS 10
+  #endif
+
+  // event bus sizing
+  #ifndef YB_EVENT_QUEUE_SIZE
+    #define YB_EVENT_QUEUE_SIZE 32
+  #endif
+  #ifndef YB_EVENT_MAX_SUBSCRIBERS
+    #define YB_EVENT_MAX_SUBSCRIBERS 16
+  #endif
+
+  // client connect / disconnect get their own queue, and publish() waits this long for room
+  #ifndef YB_EVENT_LIFECYCLE_QUEUE_SIZE
+    #define YB_EVENT_LIFECYCLE_QUEUE_SIZE 16
+  #endif
+  #ifndef YB_EVENT_LIFECYCLE_WAIT_MS
+    #define YB_EVENT_LIFECYCLE_WAIT_MS 50
+  #endif
+
+  // how long set_mqtt_config waits for the broker before giving up
+  // channels are published to mqtt / home assistant as they change, and all of them this often
+  #ifndef YB_MQTT_FULL_UPDATE_MS
+    #define YB_MQTT_FULL_UPDATE_MS 10000
+  #endif
+
+  #ifndef YB_MQTT_CONNECT_TIMEOUT_MS
+    #define YB_MQTT_CONNECT_TIMEOUT_MS 2000
+  #endif
+
+  // how long to wait for wifi to connect in client mode
+  #ifndef YB_WIFI_CONNECT_TIMEOUT_MS
+    #define YB_WIFI_CONNECT_TIMEOUT_MS 15000
+  #endif
+
+  // entries in the boot timeline
+  #ifndef YB_BOOT_TIMELINE_SIZE
+    #define YB_BOOT_TIMELINE_SIZE (YB_MAX_CONTROLLERS + 4)
+  #endif
+
 #endif // YARR_CONFIG_H
\ No newline at end of file
@@ -14,6 +14,9 @@
 #include "YarrboardDebug.h"
 #include "controllers/MQTTController.h"
 
+std::atomic<uint32_t> FastUpdateFlag::merged{0};
+etl::delegate<void()> FastUpdateFlag::onRaised;
+
 void BaseChannel::init(uint8_t id)
 {
   this->id = id;
@@ -115,9 +118,18 @@ void BaseChannel::mqttUpdate(MQTTController* mqtt)
   JsonDocument output;
   this->generateUpdate(output);
 
+  mqttUpdate(mqtt, output);
+}
+
+// update is our entry from the shared update snapshot, if we have one
+void BaseChannel::mqttUpdate(MQTTController* mqtt, JsonVariantConst update)
+{
+  if (update.isNull())
+    return mqttUpdate(mqtt);
+
   char topic[128];
   snprintf(topic, sizeof(topic), "%s/%s", this->channel_type, this->key);
-  mqtt->traverseJSON(output, topic);
+  mqtt->traverseJSON(update, topic);
 }
 
 void BaseChannel::haGenerateDiscovery(JsonVariant doc, const char* uuid, MQTTController* mqtt)
@@ -135,4 +147,10 @@ void BaseChannel::haPublishAvailable(MQTTController* mqtt)
 void BaseChannel::haPublishState(MQTTController* mqtt)
 {
   return;
+}
+
+// override this one instead to publish from the shared update snapshot (update may be null)
+void BaseChannel::haPublishUpdate(MQTTController* mqtt, JsonVariantConst update)
+{
+  haPublishState(mqtt);
 }
\ No newline at end of file
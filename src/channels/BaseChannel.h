@@ -17,8 +17,36 @@
 #include "YarrboardConfig.h"
 #include "controllers/ProtocolController.h"
 #include "etl/array.h"
+#include "etl/delegate.h"
+#include <atomic>
 #include <cstring> // for strncpy
 
+// works like a bool, but counts changes that landed while an update was already pending
+class FastUpdateFlag
+{
+  public:
+    FastUpdateFlag& operator=(bool value)
+    {
+      if (value && _pending)
+        merged++;
+      else if (value && onRaised.is_valid())
+        onRaised();
+      _pending = value;
+      return *this;
+    }
+
+    operator bool() const { return _pending; }
+
+    // across every channel, reported by get_stats
+    static std::atomic<uint32_t> merged;
+
+    // called when a flag goes from clear to set, so a sleeping main loop notices.  may be from an isr.
+    static etl::delegate<void()> onRaised;
+
+  private:
+    volatile bool _pending = false;
+};
+
 class BaseChannel
 {
   public:
@@ -27,7 +55,7 @@ class BaseChannel
     bool haEnabled = false;
     char name[YB_CHANNEL_NAME_LENGTH];
     char key[YB_CHANNEL_KEY_LENGTH];
-    volatile bool sendFastUpdate = false;
+    FastUpdateFlag sendFastUpdate;
 
     void setup();
 
@@ -43,7 +71,9 @@ class BaseChannel
     virtual void haGenerateDiscovery(JsonVariant doc, const char* uuid, MQTTController* mqtt);
     virtual void haPublishAvailable(MQTTController* mqtt);
     virtual void haPublishState(MQTTController* mqtt);
+    virtual void haPublishUpdate(MQTTController* mqtt, JsonVariantConst update);
     void mqttUpdate(MQTTController* mqtt);
+    void mqttUpdate(MQTTController* mqtt, JsonVariantConst update);
 
   protected:
     char ha_key[YB_HOSTNAME_LENGTH];
@@ -17,12 +17,14 @@
 
 AuthController::AuthController(YarrboardApp& app) : BaseController(app, "auth")
 {
+  setStartDependencies(YB_NEEDS_CONFIG);
 }
 
 bool AuthController::setup()
 {
   // init our authentication stuff
   authenticatedClients.clear();
+  revision++;
   return true;
 }
 
@@ -152,6 +154,7 @@ bool AuthController::addClientToAuthList(int socket, UserRole role)
     if (authClient.socket == socket) {
       // update role just in case
       authClient.role = role;
+      revision++;
       return true;
     }
   }
@@ -164,6 +167,7 @@ bool AuthController::addClientToAuthList(int socket, UserRole role)
 
   // add new client
   authenticatedClients.push_back({socket, role});
+  revision++;
   return true;
 }
 
@@ -172,6 +176,7 @@ void AuthController::removeClientFromAuthList(int socket)
   for (auto it = authenticatedClients.begin(); it != authenticatedClients.end(); ++it) {
     if (it->socket == socket) {
       authenticatedClients.erase(it);
+      revision++;
       break;
     }
   }
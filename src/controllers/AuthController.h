@@ -41,6 +41,9 @@ class AuthController : public BaseController
 
     etl::vector<AuthenticatedClient, YB_CLIENT_LIMIT> authenticatedClients;
 
+    // bumped whenever a client logs in or out, so others can cache roles
+    uint32_t revision = 0;
+
     bool setup() override;
 
     UserRole getUserRole(JsonVariantConst input, byte mode, int socket);
@@ -55,6 +58,7 @@ class AuthController : public BaseController
     bool isLoggedIn(JsonVariantConst input, byte mode, int socket);
     void removeClientFromAuthList(int socket);
     bool isApiClientLoggedIn(JsonVariantConst doc);
+    UserRole getWebsocketRole(JsonVariantConst doc, int socket);
 
   private:
     bool is_serial_authenticated = false;
@@ -63,7 +67,6 @@ class AuthController : public BaseController
     bool isWebsocketClientLoggedIn(JsonVariantConst input, int socket);
     bool isSerialClientLoggedIn(JsonVariantConst input);
     bool checkLoginCredentials(JsonVariantConst doc, UserRole& role);
-    UserRole getWebsocketRole(JsonVariantConst doc, int socket);
 };
 
 #endif /* !YARR_AUTH_H */
\ No newline at end of file
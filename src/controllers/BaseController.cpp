@@ -25,4 +25,29 @@ bool BaseController::start()
 {
   _started = this->setup();
   return _started;
-}
\ No newline at end of file
+}
+
+void BaseController::setLoopInterval(uint32_t interval_ms)
+{
+  _loopInterval = interval_ms;
+
+  // let the app know our schedule changed
+  if (_registered)
+    _app.rescheduleController(*this);
+}
+
+void BaseController::setNextLoop(uint32_t delay_ms)
+{
+  _nextLoopMillis = millis() + delay_ms;
+
+  if (_registered)
+    _app.rescheduleController(*this);
+}
+
+void BaseController::setExecutionPolicy(const ExecutionPolicy& policy)
+{
+  _exec = policy;
+
+  if (_registered)
+    _app.rescheduleController(*this);
+}
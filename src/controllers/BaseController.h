@@ -21,6 +21,70 @@ class YarrboardApp;
 class ConfigManager;
 class MQTTController;
 
+// hooks a controller can subscribe to.  see YarrboardApp::getHookSubscribers()
+typedef enum {
+  YB_HOOK_LOAD_CONFIG,
+  YB_HOOK_CONFIG,
+  YB_HOOK_CAPABILITIES,
+  YB_HOOK_UPDATE,
+  YB_HOOK_FAST_UPDATE,
+  YB_HOOK_STATS,
+  YB_HOOK_MQTT_UPDATE,
+  YB_HOOK_HA_UPDATE,
+  YB_HOOK_HA_DISCOVERY,
+  YB_HOOK_BRIGHTNESS,
+  YB_HOOK_COUNT
+} YBHook;
+
+static constexpr uint16_t YB_ALL_HOOKS = (1 << YB_HOOK_COUNT) - 1;
+
+// what a controller needs before its setup() can run.  see YarrboardApp::setup()
+typedef enum {
+  YB_NEEDS_NOTHING = 0,
+  YB_NEEDS_CONFIG = (1 << 0),
+  YB_NEEDS_NETWORK = (1 << 1)
+} YBStartDependency;
+
+// low priority controllers can be skipped for a pass when the main loop is over budget
+typedef enum {
+  YB_LOOP_PRIORITY_NORMAL,
+  YB_LOOP_PRIORITY_LOW
+} YBLoopPriority;
+
+typedef enum {
+  YB_EXEC_MAIN_LOOP,
+  YB_EXEC_TASK
+} YBExecMode;
+
+// Where a controller's loop() runs.  Task controllers get their own FreeRTOS task,
+// optionally pinned to a core, and talk to the main loop through lock-free queues.
+// Their hooks are still called from the main loop, http and mqtt tasks while loop()
+// runs, so a task controller has to lock its own state.
+struct ExecutionPolicy {
+    YBExecMode mode = YB_EXEC_MAIN_LOOP;
+    BaseType_t core = tskNO_AFFINITY;
+    uint32_t stackSize = 4096;
+    UBaseType_t priority = 1;
+
+    static ExecutionPolicy mainLoop() { return ExecutionPolicy(); }
+
+    static ExecutionPolicy task(uint32_t stackSize = 4096, UBaseType_t priority = 1)
+    {
+      ExecutionPolicy p;
+      p.mode = YB_EXEC_TASK;
+      p.stackSize = stackSize;
+      p.priority = priority;
+      return p;
+    }
+
+    static ExecutionPolicy pinned(BaseType_t core, uint32_t stackSize = 4096, UBaseType_t priority = 1)
+    {
+      ExecutionPolicy p = task(stackSize, priority);
+      p.core = core;
+      return p;
+    }
+};
+
 class BaseController
 {
   public:
@@ -33,6 +97,35 @@ class BaseController
     virtual void loop() {}
     const char* getName() { return _name; }
 
+    // loop() scheduling.  0 = call loop() on every pass of the main loop,
+    // otherwise loop() is only called once every interval milliseconds.
+    uint32_t getLoopInterval() { return _loopInterval; }
+    uint32_t getNextLoopMillis() { return _nextLoopMillis; }
+    void setLoopInterval(uint32_t interval_ms);
+    void setNextLoop(uint32_t delay_ms);
+
+    // how long one loop() is allowed to take.  0 = no budget.
+    uint32_t getLoopBudget() { return _loopBudget; }
+    void setLoopBudget(uint32_t budget_us) { _loopBudget = budget_us; }
+    YBLoopPriority getLoopPriority() { return _loopPriority; }
+    void setLoopPriority(YBLoopPriority priority) { _loopPriority = priority; }
+
+    // loop() timing, kept by the app
+    uint32_t getLastLoopMicros() { return _lastLoopMicros; }
+    uint32_t getWorstLoopMicros() { return _worstLoopMicros; }
+    uint32_t getWorstLoopMillis() { return _worstLoopMillis; }
+    uint32_t getBudgetOverruns() { return _budgetOverruns; }
+    uint32_t getDeferredLoops() { return _deferredLoops; }
+
+    // where loop() runs.  must be set before YarrboardApp::setup()
+    const ExecutionPolicy& getExecutionPolicy() { return _exec; }
+    void setExecutionPolicy(const ExecutionPolicy& policy);
+
+    // bitmask of YBStartDependency.  network controllers are started later,
+    // from the main loop, once the network is up.  must be set before YarrboardApp::setup()
+    uint8_t getStartDependencies() { return _startDeps; }
+    void setStartDependencies(uint8_t deps) { _startDeps = deps; }
+
     virtual bool loadConfigHook(JsonVariant config, char* error, size_t len) { return true; };
     virtual void generateConfigHook(JsonVariant config) {};
     virtual void generateCapabilitiesHook(JsonVariant config) {};
@@ -45,11 +138,41 @@ class BaseController
     virtual void haGenerateDiscoveryHook(JsonVariant components, const char* uuid, MQTTController* mqtt) {};
     virtual void updateBrightnessHook(float brightness) {};
 
+    // which hooks to call us on, given the ones registration found overridden.
+    // override this if detection can't see them, e.g. hooks added by a class you
+    // don't register as, or to turn some off.  return YB_ALL_HOOKS to get everything.
+    virtual uint16_t subscribeHooks(uint16_t detected) { return detected; }
+
+    // bitmask of YBHook, filled in at registration
+    uint16_t getHooks() { return _hooks; }
+    bool hasHook(YBHook hook) { return _hooks & (1 << hook); }
+
   protected:
     YarrboardApp& _app;
     ConfigManager& _cfg;
     const char* _name;
     bool _started = false;
+
+  private:
+    // the app owns our place in its loop schedule
+    friend class YarrboardApp;
+
+    uint32_t _loopInterval = 0;
+    uint32_t _nextLoopMillis = 0;
+    bool _rescheduled = false; // schedule changed while our loop() was running
+    bool _registered = false;
+    ExecutionPolicy _exec;
+    uint16_t _hooks = 0;
+    uint8_t _startDeps = YB_NEEDS_NOTHING;
+
+    uint32_t _loopBudget = 0;
+    YBLoopPriority _loopPriority = YB_LOOP_PRIORITY_NORMAL;
+    uint32_t _lastLoopMicros = 0;
+    uint32_t _worstLoopMicros = 0;
+    uint32_t _worstLoopMillis = 0;
+    uint32_t _budgetOverruns = 0;
+    uint32_t _deferredLoops = 0;
+    bool _startPending = false;
 };
 
 #endif
\ No newline at end of file
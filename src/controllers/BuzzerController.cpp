@@ -663,7 +663,7 @@ BuzzerController::BuzzerController(YarrboardApp& app) : BaseController(app, "buz
 
 bool BuzzerController::setup()
 {
-  _app.protocol.registerCommand(GUEST, "play_sound", this, &BuzzerController::handlePlaySound);
+  _app.protocol.registerCommand(GUEST, "play_sound", this, &BuzzerController::handlePlaySound, "melody,notes");
 
   pinMode(buzzerPin, OUTPUT);
 
@@ -25,6 +25,59 @@ class ChannelController : public BaseController
   protected:
     etl::array<ChannelType, COUNT> _channels;
 
+    // this channel's entry in the shared update, null if it isn't there
+    JsonVariantConst findUpdate(UpdateSnapshot* snapshot, const ChannelType& ch)
+    {
+      if (snapshot == nullptr)
+        return JsonVariantConst();
+
+      // they are generated in order, so this almost always hits first try
+      JsonArrayConst update = snapshot->state()[_name];
+      JsonVariantConst guess = update[ch.id - 1];
+      if (guess["id"] == ch.id)
+        return guess;
+
+      for (JsonVariantConst item : update) {
+        if (item["id"] == ch.id)
+          return item;
+      }
+
+      return JsonVariantConst();
+    }
+
+    // changed since we last published them, set from YB_EVENT_CHANNEL_CHANGED
+    bool _mqttChanged[COUNT] = {};
+    bool _haChanged[COUNT] = {};
+    uint32_t _lastMqttFull = 0;
+    uint32_t _lastHAFull = 0;
+
+    void onChannelChanged(const YBEvent& e)
+    {
+      if (e.source == nullptr || strcmp(e.source, _name))
+        return;
+
+      for (size_t i = 0; i < COUNT; i++) {
+        if (_channels[i].id == e.id) {
+          _mqttChanged[i] = true;
+          _haChanged[i] = true;
+        }
+      }
+
+      // don't wait for the next regular pass
+      _app.mqtt.setNextLoop(0);
+    }
+
+    // everyone gets published now and then, for anything that changes without telling us
+    static bool fullUpdateDue(uint32_t& last)
+    {
+      uint32_t now = millis();
+      if (last && now - last < YB_MQTT_FULL_UPDATE_MS)
+        return false;
+
+      last = now;
+      return true;
+    }
+
   public:
     ChannelController(YarrboardApp& app, const char* name) : BaseController(app, name)
     {
@@ -34,6 +87,9 @@ class ChannelController : public BaseController
         ch.init(i + 1);
         i++;
       }
+
+      _app.events.subscribe(YB_EVENT_CHANNEL_CHANGED,
+        EventBus::Handler::create<ChannelController, &ChannelController::onChannelChanged>(*this));
     }
 
     etl::array<ChannelType, COUNT>& getChannels()
@@ -121,6 +177,8 @@ class ChannelController : public BaseController
         return _app.protocol.generateErrorJSON(output, error);
       }
 
+      _app.events.publish(YBEvent(YB_EVENT_CHANNEL_CHANGED, _name, ch->id));
+
       // write it to file
       if (!_app.config.saveConfig(error, sizeof(error)))
         return _app.protocol.generateErrorJSON(output, error);
@@ -153,27 +211,52 @@ class ChannelController : public BaseController
           JsonObject jo = channels.add<JsonObject>();
           ch.generateUpdate(jo);
           ch.sendFastUpdate = false;
+
+          _app.events.publish(YBEvent(YB_EVENT_CHANNEL_CHANGED, _name, ch.id));
         }
       }
     }
 
     void mqttUpdateHook(MQTTController* mqtt) override
     {
-      for (auto& ch : _channels) {
-        if (ch.isEnabled) {
-          ch.mqttUpdate(mqtt);
+      bool full = fullUpdateDue(_lastMqttFull);
+
+      // our channels are already in the shared update, no need to generate them again.
+      // a raised fast update flag counts too, it only turns into an event if a fast update goes out.
+      UpdateSnapshot* snapshot = nullptr;
+      for (size_t i = 0; i < COUNT; i++) {
+        auto& ch = _channels[i];
+        if (ch.isEnabled && (full || _mqttChanged[i] || ch.sendFastUpdate)) {
+          if (snapshot == nullptr)
+            snapshot = _app.protocol.acquireUpdate();
+          ch.mqttUpdate(mqtt, findUpdate(snapshot, ch));
         }
+        _mqttChanged[i] = false;
       }
+
+      if (snapshot != nullptr)
+        snapshot->release();
     }
 
     void haUpdateHook(MQTTController* mqtt) override
     {
-      for (auto& ch : _channels) {
-        if (ch.isEnabled) {
-          ch.haPublishAvailable(mqtt);
-          ch.haPublishState(mqtt);
+      bool full = fullUpdateDue(_lastHAFull);
+
+      UpdateSnapshot* snapshot = nullptr;
+      for (size_t i = 0; i < COUNT; i++) {
+        auto& ch = _channels[i];
+        if (ch.isEnabled && (full || _haChanged[i] || ch.sendFastUpdate)) {
+          if (snapshot == nullptr)
+            snapshot = _app.protocol.acquireUpdate();
+          if (full)
+            ch.haPublishAvailable(mqtt);
+          ch.haPublishUpdate(mqtt, findUpdate(snapshot, ch));
         }
+        _haChanged[i] = false;
       }
+
+      if (snapshot != nullptr)
+        snapshot->release();
     }
 
     void haGenerateDiscoveryHook(JsonVariant components, const char* uuid, MQTTController* mqtt) override
@@ -50,6 +50,8 @@ void IRAM_ATTR core1_tick_cb(void)
 
 DebugController::DebugController(YarrboardApp& app) : BaseController(app, "debug"), it(YBP)
 {
+  // reset our loop times every minute.
+  setLoopInterval(60000);
 }
 
 bool DebugController::setup()
@@ -58,7 +60,7 @@ bool DebugController::setup()
   // registerCommand(ADMIN, "crashme", this, &DebugController::handleCrashMe);
 
   // startup our serial
-  Serial.begin(115200);
+  Serial.begin(YB_SERIAL_BAUD);
   Serial.setTimeout(50);
   YBP.addPrinter(Serial);
 
@@ -116,9 +118,7 @@ bool DebugController::setup()
 
 void DebugController::loop()
 {
-  // reset our loop times every minute.
-  if (INTERVAL(60000))
-    it.reset();
+  it.reset();
 }
 
 void DebugController::generateStatsHook(JsonVariant output)
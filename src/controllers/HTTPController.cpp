@@ -12,12 +12,16 @@
 
 #include "controllers/HTTPController.h"
 #include "ConfigManager.h"
+#include "JsonStream.h"
 #include "YarrboardApp.h"
 #include "YarrboardDebug.h"
 #include "controllers/ProtocolController.h"
 
+HTTPController* HTTPController::_instance = nullptr;
+
 HTTPController::HTTPController(YarrboardApp& app) : BaseController(app, "http")
 {
+  setStartDependencies(YB_NEEDS_CONFIG);
 }
 
 void HTTPController::registerGulpedFile(const GulpedFile* file, const char* path /* = nullptr */)
@@ -48,13 +52,24 @@ bool HTTPController::setup()
     return false;
   }
 
-  // prepare our message queue
-  wsRequests = xQueueCreate(YB_RECEIVE_BUFFER_COUNT, sizeof(WebsocketRequest));
-  if (wsRequests == 0) {
-    YBP.printf("Failed to create queue= %p\n", wsRequests);
+  fragmentsFree = xSemaphoreCreateCounting(YB_WEBSOCKET_FRAGMENT_BUFFERS, YB_WEBSOCKET_FRAGMENT_BUFFERS);
+  if (fragmentsFree == NULL) {
+    YBP.println("Failed to create fragment semaphore");
     return false;
   }
 
+  _instance = this; // for the async send callbacks
+
+  // prepare our message queues, one per lane
+  wsRequests[YB_LANE_CONTROL] = xQueueCreate(YB_RECEIVE_CONTROL_BUFFER_COUNT, sizeof(WebsocketRequest));
+  wsRequests[YB_LANE_POLL] = xQueueCreate(YB_RECEIVE_BUFFER_COUNT, sizeof(WebsocketRequest));
+  for (QueueHandle_t q : wsRequests) {
+    if (q == 0) {
+      YBP.println("Failed to create websocket queue");
+      return false;
+    }
+  }
+
   // do we want secure or not?
   if (_cfg.app_enable_ssl && _cfg.server_cert.length() && _cfg.server_key.length()) {
     server = new PsychicHttpsServer(443);
@@ -86,7 +101,6 @@ bool HTTPController::setup()
   });
 
   server->on("/site.webmanifest", HTTP_GET, [this](PsychicRequest* request, PsychicResponse* response) {
-    esp_err_t err = ESP_OK;
     JsonDocument doc;
 
     // Root values
@@ -105,48 +119,49 @@ bool HTTPController::setup()
     doc["theme_color"] = "#000000";
     doc["background_color"] = "#ffffff";
 
-    // we can have empty messages
-    if (doc.size()) {
-      // allocate memory for this output
-      size_t jsonSize = measureJson(doc);
-      char* jsonBuffer = (char*)malloc(jsonSize + 1);
-
-      // did we get anything?
-      if (jsonBuffer != NULL) {
-        jsonBuffer[jsonSize] = '\0'; // null terminate
-        response->setContentType("application/manifest+json");
-        serializeJson(doc.as<JsonObject>(), jsonBuffer, jsonSize + 1);
-        response->setContent(jsonBuffer);
-        err = response->send();
-
-        // no leaks!
-        free(jsonBuffer);
-      }
-      // send overloaded response
-      else {
-        YBP.println("Error allocating in web.manifest");
-        err = response->send(503, "application/manifest+json", "{}");
-      }
-    }
+    HTTPJsonStream stream(response, "application/manifest+json");
+    stream.sendJson(doc);
 
-    return err;
+    return stream.error();
   });
 
   // Our websocket handler
   websocketHandler.onFrame([this](PsychicWebSocketRequest* request, httpd_ws_frame* frame) {
-    handleWebSocketMessage(request, frame->payload, frame->len);
+    handleWebSocketMessage(request, frame->payload, frame->len, frame->type == HTTPD_WS_TYPE_BINARY);
     return ESP_OK;
   });
   websocketHandler.onOpen([this](PsychicWebSocketClient* client) {
     // YBP.printf("[socket] connection #%u connected from %s\n",
     //               client->socket(), client->remoteIP().toString());
     websocketClientCount++;
+    if (xSemaphoreTake(sendMutex, portMAX_DELAY) == pdTRUE) {
+      WebsocketClient* wc = findClient(-1);
+      if (wc != nullptr) {
+        wc->socket = client->socket();
+        wc->encoding = YB_ENCODING_JSON;
+        wc->inflight = 0;
+        wc->dropped = 0;
+        wc->filtered = false;
+        roleBucketsDirty = true;
+      }
+      xSemaphoreGive(sendMutex);
+    }
+    _app.events.publish(YBEvent(YB_EVENT_CLIENT_CONNECTED, "websocket", client->socket()));
   });
   websocketHandler.onClose([this](PsychicWebSocketClient* client) {
     // YBP.printf("[socket] connection #%u closed from %s\n", client->socket(),
     //               client->remoteIP().toString());
     _app.auth.removeClientFromAuthList(client->socket());
+    if (xSemaphoreTake(sendMutex, portMAX_DELAY) == pdTRUE) {
+      WebsocketClient* wc = findClient(client->socket());
+      if (wc != nullptr) {
+        wc->socket = -1;
+        roleBucketsDirty = true;
+      }
+      xSemaphoreGive(sendMutex);
+    }
     websocketClientCount--;
+    _app.events.publish(YBEvent(YB_EVENT_CLIENT_DISCONNECTED, "websocket", client->socket()));
   });
   server->on("/ws", &websocketHandler);
 
@@ -159,7 +174,21 @@ bool HTTPController::setup()
     JsonDocument json;
 
     String body = request->body();
-    DeserializationError err = deserializeJson(json, body);
+    if (!admitRequest(request, response, body.c_str(), body.length()))
+      return ESP_OK;
+
+    // was there a problem, officer?
+    DeserializationError err = _app.protocol.parseMessage(json, body.c_str(), body.length());
+    if (err) {
+      JsonDocument output;
+      char error[64];
+      sprintf(error, "deserializeJson() failed with code %s", err.c_str());
+      _app.protocol.generateErrorJSON(output, error);
+
+      HTTPJsonStream stream(response);
+      stream.sendJson(output);
+      return stream.error();
+    }
 
     handleWebServerRequest(json, request, response);
 
@@ -168,6 +197,10 @@ bool HTTPController::setup()
 
   // send config json
   server->on("/api/config", HTTP_ANY, [this](PsychicRequest* request, PsychicResponse* response) {
+    static const char cmd[] = "{\"cmd\":\"get_config\"}";
+    if (!admitRequest(request, response, cmd, sizeof(cmd) - 1))
+      return ESP_OK;
+
     JsonDocument json;
     json["cmd"] = "get_config";
 
@@ -178,6 +211,10 @@ bool HTTPController::setup()
 
   // send stats json
   server->on("/api/stats", HTTP_ANY, [this](PsychicRequest* request, PsychicResponse* response) {
+    static const char cmd[] = "{\"cmd\":\"get_stats\"}";
+    if (!admitRequest(request, response, cmd, sizeof(cmd) - 1))
+      return ESP_OK;
+
     JsonDocument json;
     json["cmd"] = "get_stats";
 
@@ -188,6 +225,10 @@ bool HTTPController::setup()
 
   // send update json
   server->on("/api/update", HTTP_ANY, [this](PsychicRequest* request, PsychicResponse* response) {
+    static const char cmd[] = "{\"cmd\":\"get_update\"}";
+    if (!admitRequest(request, response, cmd, sizeof(cmd) - 1))
+      return ESP_OK;
+
     JsonDocument json;
     json["cmd"] = "get_update";
 
@@ -218,55 +259,378 @@ bool HTTPController::setup()
 
 void HTTPController::loop()
 {
-  // process our websockets outside the callback.
-  WebsocketRequest request;
-  while (xQueueReceive(wsRequests, &request, 0) == pdTRUE) {
-    handleWebsocketMessageLoop(&request);
+  // process our websockets outside the callback, control lane first.
+  uint32_t start = micros();
+  bool first = true;
+  for (uint8_t lane = 0; lane < YB_LANE_COUNT; lane++) {
+    WebsocketRequest request;
+    while (uxQueueMessagesWaiting(wsRequests[lane])) {
+      // always do at least one, so we can't stall completely
+      if (!first && receive_drain_budget_us && micros() - start >= receive_drain_budget_us) {
+        drainBudgetHits++;
+
+        // come back for the rest next pass
+        _app.wakeLoop();
+        return;
+      }
+
+      if (xQueueReceive(wsRequests[lane], &request, 0) != pdTRUE)
+        break;
+
+      laneStats[lane].wait.add(micros() - request.queued_us);
+      handleWebsocketMessageLoop(&request);
+      first = false;
 
-    // make sure to release our memory!
-    free(request.buffer);
+      // make sure to release our memory!
+      free(request.buffer);
+
+      // a control message may have shown up while we were busy with a poll
+      if (lane > YB_LANE_CONTROL && uxQueueMessagesWaiting(wsRequests[YB_LANE_CONTROL]))
+        lane = YB_LANE_CONTROL;
+    }
+  }
+}
+
+void HTTPController::generateStatsHook(JsonVariant output)
+{
+  JsonObject lanes = output["websocket_lanes"].to<JsonObject>();
+  lanes["drain_budget_us"] = receive_drain_budget_us;
+  lanes["drain_budget_hits"] = drainBudgetHits;
+
+  for (uint8_t lane = 0; lane < YB_LANE_COUNT; lane++) {
+    JsonObject l = lanes[ProtocolController::getLaneName((YBLane)lane)].to<JsonObject>();
+    l["waiting"] = wsRequests[lane] ? uxQueueMessagesWaiting(wsRequests[lane]) : 0;
+    l["processed"] = laneStats[lane].wait.count;
+    l["full"] = laneStats[lane].full;
+    laneStats[lane].wait.generateStats(l["wait"].to<JsonObject>());
   }
 }
 
 void HTTPController::sendToAllWebsockets(const char* jsonString, UserRole auth_level)
+{
+  broadcast(JsonVariantConst(), jsonString, auth_level, false);
+}
+
+void HTTPController::sendToAllWebsockets(JsonVariantConst doc, UserRole auth_level, bool skipFiltered)
+{
+  broadcast(doc, nullptr, auth_level, skipFiltered);
+}
+
+bool HTTPController::sendToWebsocket(int socket, JsonVariantConst doc, UserRole auth_level)
 {
   // if the mutex hasn't been created yet, we're not ready to send
   if (sendMutex == NULL) {
-    return;
+    return false;
   }
 
   // make sure we're allowed to see the message
-  if (auth_level > _cfg.app_default_role) {
-    for (byte i = 0; i < YB_CLIENT_LIMIT; i++) {
-      if (_app.auth.authenticatedClients[i].socket) {
-        // make sure its a valid client
-        PsychicWebSocketClient* client =
-          websocketHandler.getClient(_app.auth.authenticatedClients[i].socket);
-        if (client == NULL)
-          continue;
+  if (_app.auth.getWebsocketRole(JsonVariantConst(), socket) < auth_level)
+    return false;
 
-        if (_app.auth.authenticatedClients[i].role >= auth_level) {
-          if (xSemaphoreTake(sendMutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-            client->sendMessage(jsonString);
-            xSemaphoreGive(sendMutex);
-          } else {
-            // dont use YBP here because it will get recursive.
-            Serial.println("client->sendMessage mutex fail");
+  if (xSemaphoreTake(sendMutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    // dont use YBP here because it will get recursive.
+    Serial.println("sendToWebsocket mutex fail");
+    return false;
+  }
+
+  bool ok = false;
+  WebsocketClient* wc = findClient(socket);
+  if (wc != nullptr) {
+    if (wc->inflight >= YB_WEBSOCKET_MAX_INFLIGHT) {
+      wc->dropped++;
+      websocketDropped++;
+    } else {
+      WebsocketStream stream(*this, wc, wc->encoding == YB_ENCODING_MSGPACK);
+      if (wc->encoding == YB_ENCODING_MSGPACK)
+        ok = stream.sendMsgPack(doc);
+      else
+        ok = stream.sendJson(doc);
+    }
+  }
+
+  xSemaphoreGive(sendMutex);
+
+  return ok;
+}
+
+void HTTPController::setClientFiltered(int socket, bool filtered)
+{
+  if (sendMutex == NULL)
+    return;
+
+  // broadcast() reads this while it walks the clients
+  if (xSemaphoreTake(sendMutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    // dont use YBP here because it will get recursive.
+    Serial.println("setClientFiltered mutex fail");
+    return;
+  }
+
+  WebsocketClient* wc = findClient(socket);
+  if (wc != nullptr)
+    wc->filtered = filtered;
+
+  xSemaphoreGive(sendMutex);
+}
+
+void HTTPController::broadcast(JsonVariantConst doc, const char* jsonString, UserRole auth_level, bool skipFiltered)
+{
+  // if the mutex hasn't been created yet, we're not ready to send
+  if (sendMutex == NULL) {
+    return;
+  }
+
+  // nothing in here blocks on the network, so we can afford to wait our turn
+  if (xSemaphoreTake(sendMutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    // dont use YBP here because it will get recursive.
+    Serial.println("sendToAllWebsockets mutex fail");
+    return;
+  }
+
+  // did anyone log in or out?
+  if (roleBucketsDirty || roleBucketsRevision != _app.auth.revision ||
+      roleBucketsDefaultRole != _cfg.app_default_role)
+    rebuildRoleBuckets();
+
+  // serialized once per format, the first time a client needs it
+  BroadcastBuffer* json = nullptr;
+  BroadcastBuffer* msgpack = nullptr;
+  JsonDocument parsed;
+
+  for (int role = auth_level; role <= ADMIN; role++) {
+    for (WebsocketClient* wc : roleBuckets[role]) {
+      // they get their own copy
+      if (skipFiltered && wc->filtered)
+        continue;
+
+      // a slow client only misses its own messages
+      if (wc->inflight >= YB_WEBSOCKET_MAX_INFLIGHT) {
+        wc->dropped++;
+        websocketDropped++;
+        continue;
+      }
+
+      bool binary = wc->encoding == YB_ENCODING_MSGPACK;
+      BroadcastBuffer*& buffer = binary ? msgpack : json;
+
+      if (buffer == nullptr) {
+        if (binary) {
+          // no document?  rebuild it from the json.
+          if (doc.isNull()) {
+            if (deserializeJson(parsed, jsonString))
+              continue;
+            doc = parsed.as<JsonVariantConst>();
           }
+          buffer = BroadcastBuffer::fromMsgPack(doc);
+        } else if (jsonString != nullptr)
+          buffer = BroadcastBuffer::fromBytes(jsonString, strlen(jsonString));
+        else
+          buffer = BroadcastBuffer::fromJson(doc);
+
+        if (buffer == nullptr) {
+          Serial.println("Error allocating in sendToAllWebsockets");
+          continue;
         }
       }
+
+      queueFrame(wc, buffer, binary ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT);
     }
   }
-  // nope, just send it to all.
-  else {
-    if (xSemaphoreTake(sendMutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-      websocketHandler.sendAll(jsonString);
-      xSemaphoreGive(sendMutex);
-    } else {
-      // dont use YBP here because it will get recursive.
-      Serial.println("websocketHandler.sendAll mutex fail");
+
+  xSemaphoreGive(sendMutex);
+
+  // drop our reference, the queued sends hold their own
+  if (json != nullptr)
+    json->release();
+  if (msgpack != nullptr)
+    msgpack->release();
+}
+
+void HTTPController::rebuildRoleBuckets()
+{
+  for (auto& bucket : roleBuckets)
+    bucket.clear();
+
+  for (auto& wc : websocketClients) {
+    if (wc.socket != -1)
+      roleBuckets[_app.auth.getWebsocketRole(JsonVariantConst(), wc.socket)].push_back(&wc);
+  }
+
+  roleBucketsDirty = false;
+  roleBucketsRevision = _app.auth.revision;
+  roleBucketsDefaultRole = _cfg.app_default_role;
+}
+
+HTTPController::WebsocketClient* HTTPController::findClient(int socket)
+{
+  for (auto& wc : websocketClients) {
+    if (wc.socket == socket)
+      return &wc;
+  }
+
+  return nullptr;
+}
+
+esp_err_t HTTPController::queueFrame(WebsocketClient* wc, BroadcastBuffer* buffer, httpd_ws_type_t type,
+  bool fragmented, bool final)
+{
+  // the send holds its own reference until sendComplete()
+  buffer->retain();
+
+  esp_err_t err = queueBytes(wc, buffer->data(), buffer->length(), type, fragmented, final, sendComplete, buffer);
+  if (err != ESP_OK)
+    buffer->release();
+
+  return err;
+}
+
+esp_err_t HTTPController::queueBytes(WebsocketClient* wc, uint8_t* data, size_t len, httpd_ws_type_t type,
+  bool fragmented, bool final, transfer_complete_cb callback, void* arg)
+{
+  httpd_ws_frame_t frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.type = type;
+  frame.fragmented = fragmented;
+  frame.final = final;
+  frame.payload = data;
+  frame.len = len;
+
+  wc->inflight++;
+
+  esp_err_t err = httpd_ws_send_data_async(server->server, wc->socket, &frame, callback, arg);
+  if (err != ESP_OK)
+    wc->inflight--;
+  else if (wc->encoding == YB_ENCODING_MSGPACK)
+    bytesSentMsgPack += frame.len;
+  else
+    bytesSentJson += frame.len;
+
+  return err;
+}
+
+void HTTPController::queueMessage(int socket, const char* message)
+{
+  if (xSemaphoreTake(sendMutex, portMAX_DELAY) != pdTRUE)
+    return;
+
+  WebsocketClient* wc = findClient(socket);
+  if (wc != nullptr) {
+    BroadcastBuffer* buffer = BroadcastBuffer::fromBytes(message, strlen(message));
+    if (buffer != nullptr) {
+      queueFrame(wc, buffer, HTTPD_WS_TYPE_TEXT);
+      buffer->release();
     }
   }
+
+  xSemaphoreGive(sendMutex);
+}
+
+// runs on the http server task once the frame has gone out (or failed)
+void HTTPController::sendComplete(esp_err_t err, int socket, void* arg)
+{
+  static_cast<BroadcastBuffer*>(arg)->release();
+
+  if (_instance != nullptr)
+    _instance->frameSent(socket);
+}
+
+void HTTPController::fragmentComplete(esp_err_t err, int socket, void* arg)
+{
+  if (_instance == nullptr)
+    return;
+
+  _instance->giveFragmentBuffer(static_cast<FragmentBuffer*>(arg));
+  _instance->frameSent(socket);
+}
+
+void HTTPController::frameSent(int socket)
+{
+  WebsocketClient* wc = findClient(socket);
+  if (wc != nullptr && wc->inflight)
+    wc->inflight--;
+}
+
+HTTPController::FragmentBuffer* HTTPController::takeFragmentBuffer()
+{
+  // wait for the server task to finish with one
+  if (xSemaphoreTake(fragmentsFree, pdMS_TO_TICKS(YB_WEBSOCKET_FRAGMENT_WAIT_MS)) != pdTRUE)
+    return nullptr;
+
+  for (auto& fb : fragmentBuffers) {
+    if (!fb.busy.exchange(true))
+      return &fb;
+  }
+
+  // the semaphore counts them, so we shouldn't get here
+  xSemaphoreGive(fragmentsFree);
+  return nullptr;
+}
+
+void HTTPController::giveFragmentBuffer(FragmentBuffer* fb)
+{
+  fb->busy = false;
+  xSemaphoreGive(fragmentsFree);
+}
+
+bool HTTPController::WebsocketStream::sendChunk(const uint8_t* data, size_t len, bool first, bool last)
+{
+  // a reply in pieces can't be given up on halfway, so only start one if the client is keeping up
+  if (first && !last && _client->inflight > YB_WEBSOCKET_MAX_INFLIGHT / 2) {
+    _client->dropped++;
+    _http.websocketDropped++;
+    return false;
+  }
+
+  // copied into one of the fixed buffers, this waits if they are all still queued
+  esp_err_t err = ESP_FAIL;
+  FragmentBuffer* fb = _http.takeFragmentBuffer();
+  if (fb != nullptr) {
+    memcpy(fb->data, data, len);
+
+    // only the first fragment has the real type, the rest are continuations
+    httpd_ws_type_t type = HTTPD_WS_TYPE_CONTINUE;
+    if (first)
+      type = _binary ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT;
+
+    err = _http.queueBytes(_client, fb->data, len, type, !(first && last), last, fragmentComplete, fb);
+    if (err != ESP_OK)
+      _http.giveFragmentBuffer(fb);
+  }
+
+  // the client has half a message it can never finish, the next frame would corrupt it.  hang up.
+  if (err != ESP_OK && !first)
+    httpd_sess_trigger_close(_http.server->server, _client->socket);
+
+  return err == ESP_OK;
+}
+
+bool HTTPController::setClientEncoding(int socket, YBEncoding encoding)
+{
+  if (sendMutex == NULL)
+    return false;
+
+  // not in the middle of a send to this client
+  if (xSemaphoreTake(sendMutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    // dont use YBP here because it will get recursive.
+    Serial.println("setClientEncoding mutex fail");
+    return false;
+  }
+
+  WebsocketClient* wc = findClient(socket);
+  if (wc != nullptr)
+    wc->encoding = encoding;
+
+  xSemaphoreGive(sendMutex);
+
+  return wc != nullptr;
+}
+
+YBEncoding HTTPController::getClientEncoding(int socket)
+{
+  WebsocketClient* wc = findClient(socket);
+  if (wc == nullptr)
+    return YB_ENCODING_JSON;
+
+  return wc->encoding;
 }
 
 esp_err_t HTTPController::handleWebServerRequest(JsonVariant input, PsychicRequest* request, PsychicResponse* response)
@@ -274,13 +638,16 @@ esp_err_t HTTPController::handleWebServerRequest(JsonVariant input, PsychicReque
   esp_err_t err = ESP_OK;
   JsonDocument output;
 
+  // batches carry their credentials in the first command
+  JsonVariant credentials = input.is<JsonArray>() ? input[0] : input;
+
   if (request->hasParam("user"))
-    input["user"] = request->getParam("user")->value();
+    credentials["user"] = request->getParam("user")->value();
   if (request->hasParam("pass"))
-    input["pass"] = request->getParam("pass")->value();
+    credentials["pass"] = request->getParam("pass")->value();
 
   if (_cfg.app_enable_api) {
-    _app.auth.isApiClientLoggedIn(input);
+    _app.auth.isApiClientLoggedIn(credentials);
 
     ProtocolContext context;
     context.mode = YBP_MODE_HTTP;
@@ -292,26 +659,9 @@ esp_err_t HTTPController::handleWebServerRequest(JsonVariant input, PsychicReque
 
   // we can have empty messages
   if (output.size()) {
-    // allocate memory for this output
-    size_t jsonSize = measureJson(output);
-    char* jsonBuffer = (char*)malloc(jsonSize + 1);
-
-    // did we get anything?
-    if (jsonBuffer != NULL) {
-      jsonBuffer[jsonSize] = '\0'; // null terminate
-      response->setContentType("application/json");
-      serializeJson(output.as<JsonObject>(), jsonBuffer, jsonSize + 1);
-      response->setContent(jsonBuffer);
-      err = response->send();
-    }
-    // send overloaded response
-    else {
-      YBP.println("Error allocating in handleWebServerRequest()");
-      err = response->send(503, "application/json", "{}");
-    }
-
-    // no leaks!
-    free(jsonBuffer);
+    HTTPJsonStream stream(response);
+    stream.sendJson(output);
+    err = stream.error();
   }
   // give them valid json at least
   else
@@ -320,14 +670,47 @@ esp_err_t HTTPController::handleWebServerRequest(JsonVariant input, PsychicReque
   return err;
 }
 
+// false if they are over the rate limit, in which case they've already been answered
+bool HTTPController::admitRequest(PsychicRequest* request, PsychicResponse* response, const char* data, size_t len)
+{
+  // keyed by ip, since pollers often open a new connection every time
+  uint32_t ip = request->client()->remoteIP();
+  if (_app.protocol.admitMessage(YBP_MODE_HTTP, ip, data, len) == YB_ADMIT_OK)
+    return true;
+
+  // http always needs an answer, even a repeat offender
+  response->setCode(429);
+  response->setContentType("application/json");
+  response->setContent(ProtocolController::rateLimitedJSON);
+  response->send();
+
+  return false;
+}
+
 void HTTPController::handleWebSocketMessage(PsychicWebSocketRequest* request, uint8_t* data,
-  size_t len)
+  size_t len, bool binary)
 {
+  // a quick look at the command, without parsing the whole thing
+  char cmd[YB_PROTOCOL_MAX_COMMAND_LENGTH];
+  uint8_t count = ProtocolController::scanCommand((const char*)data, len, binary, cmd, sizeof(cmd));
+  const char* name = count ? cmd : nullptr;
+
+  // over the limit?  don't bother copying or queueing it.
+  int socket = request->client()->socket();
+  YBAdmit admit = _app.protocol.admitCommand(YBP_MODE_WEBSOCKET, socket, name, count);
+  if (admit != YB_ADMIT_OK) {
+    if (admit == YB_ADMIT_REJECT)
+      queueMessage(socket, ProtocolController::rateLimitedJSON);
+    return;
+  }
+
   // build our websocket request - copy the existing one
   // we are allocating memory here, and the worker will free it
   WebsocketRequest wr;
-  wr.socket = request->client()->socket();
+  wr.socket = socket;
   wr.len = len + 1;
+  wr.binary = binary;
+  wr.queued_us = micros();
   wr.buffer = (char*)malloc(len + 1);
 
   // did we flame out?
@@ -339,25 +722,29 @@ void HTTPController::handleWebSocketMessage(PsychicWebSocketRequest* request, ui
   // okay, copy it over
   memcpy(wr.buffer, data, len + 1);
 
-  // throw it in our queue
-  if (xQueueSend(wsRequests, &wr, 1) != pdTRUE) {
+  // throw it in the queue for its lane
+  YBLane lane = _app.protocol.getCommandLane(name);
+  if (xQueueSend(wsRequests[lane], &wr, 1) != pdTRUE) {
     // request->client()->close();
-    YBP.printf("[socket] queue full #%d\n", wr.socket);
+    YBP.printf("[socket] %s queue full #%d\n", ProtocolController::getLaneName(lane), wr.socket);
+    laneStats[lane].full++;
 
     // free the memory... no worker to do it for us.
     free(wr.buffer);
   }
+  // let the main loop know it has work.
+  else
+    _app.wakeLoop();
 
   // send a throttle message if we're full
-  if (!uxQueueSpacesAvailable(wsRequests))
-    request->reply("{\"error\":\"Queue Full\"}");
+  if (!uxQueueSpacesAvailable(wsRequests[lane]))
+    queueMessage(wr.socket, "{\"error\":\"Queue Full\"}");
 }
 
 void HTTPController::handleWebsocketMessageLoop(WebsocketRequest* request)
 {
   // make sure our client is still good.
-  PsychicWebSocketClient* client = websocketHandler.getClient(request->socket);
-  if (client == NULL) {
+  if (findClient(request->socket) == nullptr) {
     // YBP.printf("[socket] client #%d bad, bailing\n", request->socket);
     return;
   }
@@ -366,42 +753,39 @@ void HTTPController::handleWebsocketMessageLoop(WebsocketRequest* request)
   JsonDocument input;
 
   // was there a problem, officer?
-  DeserializationError err = deserializeJson(input, request->buffer);
+  DeserializationError err = _app.protocol.parseMessage(input, request->buffer, request->len - 1, request->binary);
+
   if (err) {
     char error[64];
-    sprintf(error, "deserializeJson() failed with code %s", err.c_str());
+    sprintf(error, "%s() failed with code %s", request->binary ? "deserializeMsgPack" : "deserializeJson", err.c_str());
     _app.protocol.generateErrorJSON(output, error);
   } else {
     ProtocolContext context;
     context.mode = YBP_MODE_WEBSOCKET;
-    context.clientId = client->socket();
+    context.clientId = request->socket;
+    context.encoding = request->binary ? YB_ENCODING_MSGPACK : YB_ENCODING_JSON;
     _app.protocol.handleReceivedJSON(input, output, context);
   }
 
   // empty messages are valid, so don't send a response
   if (output.size()) {
-    // allocate memory for this output
-    size_t jsonSize = measureJson(output);
-    char* jsonBuffer = (char*)malloc(jsonSize + 1);
-
-    // did we get anything?
-    if (jsonBuffer != NULL) {
-      serializeJson(output, jsonBuffer, jsonSize + 1);
-      jsonBuffer[jsonSize] = '\0'; // null terminate
-
-      if (xSemaphoreTake(sendMutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        client->sendMessage(jsonBuffer);
-        xSemaphoreGive(sendMutex);
-      } else {
-        Serial.println("handleWebsocketMessageLoop send mutex fail");
+    // held for the whole reply so no broadcast lands between its fragments
+    if (xSemaphoreTake(sendMutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+      WebsocketClient* wc = findClient(request->socket);
+      if (wc != nullptr) {
+        // binary in, binary out.
+        WebsocketStream stream(*this, wc, request->binary);
+        if (request->binary)
+          stream.sendMsgPack(output);
+        else
+          stream.sendJson(output);
       }
-
-      _app.protocol.incrementSentMessages();
-
-      free(jsonBuffer);
+      xSemaphoreGive(sendMutex);
     } else {
-      YBP.println("Error allocating in handleWebsocketMessageLoop()");
+      Serial.println("handleWebsocketMessageLoop send mutex fail");
     }
+
+    _app.protocol.incrementSentMessages();
   }
 }
 
@@ -15,15 +15,22 @@
 
 #include "YarrboardConfig.h"
 
+#include "BroadcastBuffer.h"
+
 #include "GulpedFile.h"
+#include "JsonStream.h"
 #include "controllers/AuthController.h"
 #include "controllers/BaseController.h"
+#include "controllers/ProtocolController.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <PsychicHttp.h>
 #include <PsychicHttpsServer.h>
+#include <atomic>
 #include <freertos/queue.h>
+#include <etl/array.h>
 #include <etl/map.h>
+#include <etl/vector.h>
 
 #define MAX_GULPED_FILES 32
 
@@ -31,6 +38,8 @@ typedef struct {
     int socket;
     char* buffer;
     size_t len;
+    bool binary;
+    uint32_t queued_us; // for measuring time spent waiting in its lane
 } WebsocketRequest;
 
 class YarrboardApp;
@@ -45,6 +54,15 @@ class HTTPController : public BaseController
     void loop() override;
 
     void sendToAllWebsockets(const char* jsonString, UserRole auth_level);
+    void sendToAllWebsockets(JsonVariantConst doc, UserRole auth_level, bool skipFiltered = false);
+    bool sendToWebsocket(int socket, JsonVariantConst doc, UserRole auth_level);
+
+    // filtered clients have their own subscriptions, and are skipped by sendToAllWebsockets(..., true)
+    void setClientFiltered(int socket, bool filtered);
+
+    // msgpack clients get binary frames, everyone else gets json text
+    bool setClientEncoding(int socket, YBEncoding encoding);
+    YBEncoding getClientEncoding(int socket);
     void registerGulpedFile(const GulpedFile* file, const char* path = nullptr);
     void registerGulpedFiles(const GulpedFile* files[], int count);
 
@@ -54,13 +72,89 @@ class HTTPController : public BaseController
     unsigned int websocketClientCount = 0;
     unsigned int httpClientCount = 0;
 
+    // broadcasts skipped because that client already had too many queued
+    uint32_t websocketDropped = 0;
+
+    // websocket payload bytes queued, by encoding
+    uint32_t bytesSentJson = 0;
+    uint32_t bytesSentMsgPack = 0;
+
+    // most time loop() spends on queued websocket messages per pass, 0 = no limit
+    uint32_t receive_drain_budget_us = YB_RECEIVE_DRAIN_BUDGET_US;
+
+    void generateStatsHook(JsonVariant output) override;
+
   private:
     PsychicHttpServer* server;
     PsychicWebSocketHandler websocketHandler;
     char last_modified[50];
-    QueueHandle_t wsRequests;
+    QueueHandle_t wsRequests[YB_LANE_COUNT] = {};
+
+    // per lane: how long messages waited, and how many didn't fit
+    struct LaneStats {
+        LatencyHistogram wait;
+        uint32_t full = 0;
+    };
+    LaneStats laneStats[YB_LANE_COUNT];
+    uint32_t drainBudgetHits = 0;
     SemaphoreHandle_t sendMutex;
 
+    // socket -1 is a free slot.  slots never move, so pointers to them stay valid.
+    struct WebsocketClient {
+        int socket = -1;
+        YBEncoding encoding = YB_ENCODING_JSON;
+        std::atomic<uint8_t> inflight{0};
+        uint32_t dropped = 0;
+        bool filtered = false;
+    };
+    etl::array<WebsocketClient, YB_CLIENT_LIMIT> websocketClients;
+
+    // clients grouped by the role they see messages as, rebuilt when someone logs in or out
+    etl::vector<WebsocketClient*, YB_CLIENT_LIMIT> roleBuckets[ADMIN + 1];
+    bool roleBucketsDirty = true;
+    uint32_t roleBucketsRevision = 0;
+    UserRole roleBucketsDefaultRole = NOBODY;
+
+    WebsocketClient* findClient(int socket);
+    void rebuildRoleBuckets();
+    void broadcast(JsonVariantConst doc, const char* jsonString, UserRole auth_level, bool skipFiltered);
+
+    // every websocket send is queued to the server task, so frames never interleave
+    esp_err_t queueFrame(WebsocketClient* wc, BroadcastBuffer* buffer, httpd_ws_type_t type, bool fragmented = false, bool final = true);
+    esp_err_t queueBytes(WebsocketClient* wc, uint8_t* data, size_t len, httpd_ws_type_t type, bool fragmented, bool final,
+      transfer_complete_cb callback, void* arg);
+    void queueMessage(int socket, const char* message);
+    static void sendComplete(esp_err_t err, int socket, void* arg);
+    void frameSent(int socket);
+
+    // replies stream out through these, so a big one never has more than a few fragments queued.
+    // only one reply streams at a time, under sendMutex.  never wait on them from the server task.
+    struct FragmentBuffer {
+        uint8_t data[YB_JSON_STREAM_BUFFER_SIZE];
+        std::atomic<bool> busy{false};
+    };
+    FragmentBuffer fragmentBuffers[YB_WEBSOCKET_FRAGMENT_BUFFERS];
+    SemaphoreHandle_t fragmentsFree = NULL;
+    FragmentBuffer* takeFragmentBuffer();
+    void giveFragmentBuffer(FragmentBuffer* fb);
+    static void fragmentComplete(esp_err_t err, int socket, void* arg);
+    static HTTPController* _instance;
+
+    // replies are streamed out as websocket fragments
+    class WebsocketStream : public JsonStream
+    {
+      public:
+        WebsocketStream(HTTPController& http, WebsocketClient* client, bool binary) : _http(http), _client(client), _binary(binary) {}
+
+      protected:
+        bool sendChunk(const uint8_t* data, size_t len, bool first, bool last) override;
+
+      private:
+        HTTPController& _http;
+        WebsocketClient* _client;
+        bool _binary;
+    };
+
     struct CStringCompare {
         bool operator()(const char* a, const char* b) const {
             return strcmp(a, b) < 0;
@@ -70,7 +164,8 @@ class HTTPController : public BaseController
 
     void handleWebsocketMessageLoop(WebsocketRequest* request);
     esp_err_t handleWebServerRequest(JsonVariant input, PsychicRequest* request, PsychicResponse* response);
-    void handleWebSocketMessage(PsychicWebSocketRequest* request, uint8_t* data, size_t len);
+    bool admitRequest(PsychicRequest* request, PsychicResponse* response, const char* data, size_t len);
+    void handleWebSocketMessage(PsychicWebSocketRequest* request, uint8_t* data, size_t len, bool binary);
     esp_err_t handleGulpedFile(PsychicRequest* request, PsychicResponse* response);
 };
 
@@ -20,6 +20,12 @@ MQTTController* MQTTController::_instance = nullptr;
 
 MQTTController::MQTTController(YarrboardApp& app) : BaseController(app, "mqtt")
 {
+  // periodically update our mqtt / HomeAssistant status
+  setLoopInterval(1000);
+  setStartDependencies(YB_NEEDS_CONFIG | YB_NEEDS_NETWORK);
+
+  // registered now so the command list is done before http starts serving.  setup() waits on the network.
+  _app.protocol.registerCommand(ADMIN, "set_mqtt_config", this, &MQTTController::handleSetMQTTConfig, "app_enable_mqtt,app_enable_mqtt_protocol,app_enable_ha_integration,app_use_hostname_as_mqtt_uuid,mqtt_server,mqtt_user,mqtt_pass,mqtt_cert");
 }
 
 bool MQTTController::setup()
@@ -29,8 +35,6 @@ bool MQTTController::setup()
     return false;
   }
 
-  _app.protocol.registerCommand(ADMIN, "set_mqtt_config", this, &MQTTController::handleSetMQTTConfig);
-
   _instance = this; // Capture the instance for callbacks
 
   // on connect home hook
@@ -50,7 +54,13 @@ bool MQTTController::setup()
     });
   }
 
-  return connect(true);
+  // don't hold up the loop waiting on the broker, loop() keeps an eye on it
+  if (_cfg.app_enable_mqtt) {
+    connect(false);
+    watchConnect(0);
+  }
+
+  return true;
 }
 
 bool MQTTController::connect(bool waitBlocking)
@@ -92,27 +102,25 @@ bool MQTTController::connect(bool waitBlocking)
 
 void MQTTController::loop()
 {
+  // set_mqtt_config wants a fresh connection
+  if (_reconnectRequested.exchange(false))
+    startReconnect(_reconnectToken.exchange(0));
+
+  if (_reconnecting)
+    checkReconnect();
+
   if (!mqttClient.connected())
     return;
 
-  // periodically update our mqtt / HomeAssistant status
-  unsigned int messageDelta = millis() - previousMQTTMillis;
-  if (messageDelta >= 1000) {
-    if (mqttClient.connected()) {
-
-      for (const auto& entry : _app.getControllers()) {
-        entry.controller->mqttUpdateHook(this);
-      }
+  for (BaseController* c : _app.getHookSubscribers(YB_HOOK_MQTT_UPDATE)) {
+    c->mqttUpdateHook(this);
+  }
 
-      // separately update our Home Assistant status
-      if (_cfg.app_enable_ha_integration) {
-        for (const auto& entry : _app.getControllers()) {
-          entry.controller->haUpdateHook(this);
-        }
-      }
+  // separately update our Home Assistant status
+  if (_cfg.app_enable_ha_integration) {
+    for (BaseController* c : _app.getHookSubscribers(YB_HOOK_HA_UPDATE)) {
+      c->haUpdateHook(this);
     }
-
-    previousMQTTMillis = millis();
   }
 }
 
@@ -133,13 +141,76 @@ void MQTTController::handleSetMQTTConfig(JsonVariantConst input, JsonVariant out
   if (!_cfg.saveConfig(error, sizeof(error)))
     return _app.protocol.generateErrorJSON(output, error);
 
-  // init our mqtt
+  // no wifi, it gets used once we've been set up on a real connection.
+  if (!isStarted())
+    return;
+
+  // the broker can take a while, so loop() answers once we know how it went.
+  uint32_t token = 0;
   if (_cfg.app_enable_mqtt) {
-    disconnect(); // reset our connection.
-    if (!connect())
-      return _app.protocol.generateErrorJSON(output, "Error connecting to MQTT server.");
-  } else
-    disconnect();
+    token = _app.protocol.deferReply(output, context);
+    if (!token)
+      return _app.protocol.generateErrorJSON(output, "Too many pending commands, try again.");
+  }
+
+  // only the newest request gets connected, an older one still waiting is told so
+  uint32_t old = _reconnectToken.exchange(token);
+  _reconnectRequested = true;
+  if (old) {
+    JsonDocument result;
+    _app.protocol.generateErrorJSON(result, "Replaced by a newer set_mqtt_config.");
+    _app.protocol.completeDeferred(old, result);
+  }
+}
+
+void MQTTController::startReconnect(uint32_t token)
+{
+  if (_reconnecting)
+    finishReconnect("Replaced by a newer set_mqtt_config.");
+
+  // reset our connection.
+  disconnect();
+  if (!_cfg.app_enable_mqtt)
+    return;
+
+  connect(false);
+  watchConnect(token);
+}
+
+void MQTTController::watchConnect(uint32_t token)
+{
+  _reconnecting = true;
+  _reconnectFor = token;
+  _reconnectStarted = millis();
+  setNextLoop(100);
+}
+
+void MQTTController::checkReconnect()
+{
+  if (mqttClient.connected())
+    return finishReconnect(nullptr);
+
+  if (millis() - _reconnectStarted >= YB_MQTT_CONNECT_TIMEOUT_MS) {
+    mqttClient.forceStop();
+    YBP.println("MQTT failed to connect.");
+    return finishReconnect("Error connecting to MQTT server.");
+  }
+
+  // check back soon, not on our regular interval
+  setNextLoop(100);
+}
+
+void MQTTController::finishReconnect(const char* error)
+{
+  JsonDocument result;
+  if (error)
+    _app.protocol.generateErrorJSON(result, error);
+
+  if (_reconnectFor)
+    _app.protocol.completeDeferred(_reconnectFor, result);
+
+  _reconnecting = false;
+  _reconnectFor = 0;
 }
 
 void MQTTController::generateStatsHook(JsonVariant output)
@@ -190,8 +261,16 @@ void MQTTController::receiveMessage(const char* topic, const char* payload, int
   if (!_cfg.app_enable_mqtt_protocol)
     return;
 
+  // all mqtt commands come from the broker, so they share one bucket
+  YBAdmit admit = _app.protocol.admitMessage(YBP_MODE_MQTT, 0, payload, strlen(payload));
+  if (admit != YB_ADMIT_OK) {
+    if (admit == YB_ADMIT_REJECT)
+      this->publish("response", ProtocolController::rateLimitedJSON);
+    return;
+  }
+
   JsonDocument input;
-  DeserializationError err = deserializeJson(input, payload);
+  DeserializationError err = _app.protocol.parseMessage(input, payload, strlen(payload));
   JsonDocument output;
 
   if (err) {
@@ -205,23 +284,27 @@ void MQTTController::receiveMessage(const char* topic, const char* payload, int
   }
 
   // we can have empty responses
-  if (output.size()) {
-    // dynamically allocate our buffer
-    size_t jsonSize = measureJson(output);
-    char* jsonBuffer = (char*)malloc(jsonSize + 1);
-
-    // did we get anything?
-    if (jsonBuffer != NULL) {
-      jsonBuffer[jsonSize] = '\0'; // null terminate
-      serializeJson(output, jsonBuffer, jsonSize + 1);
-
-      // post our response
-      this->publish("response", jsonBuffer);
-      free(jsonBuffer);
-    } else {
-      // dont call YBP b/c loops...
-      YBP.println("Error allocating in MQTTController::receiveMessage");
-    }
+  if (output.size())
+    publishResponse(output);
+}
+
+void MQTTController::publishResponse(JsonVariantConst output)
+{
+  // dynamically allocate our buffer
+  size_t jsonSize = measureJson(output);
+  char* jsonBuffer = (char*)malloc(jsonSize + 1);
+
+  // did we get anything?
+  if (jsonBuffer != NULL) {
+    jsonBuffer[jsonSize] = '\0'; // null terminate
+    serializeJson(output, jsonBuffer, jsonSize + 1);
+
+    // post our response
+    this->publish("response", jsonBuffer);
+    free(jsonBuffer);
+  } else {
+    // dont call YBP b/c loops...
+    YBP.println("Error allocating in MQTTController::publishResponse");
   }
 }
 
@@ -331,8 +414,8 @@ void MQTTController::haDiscovery()
   // our components array
   JsonObject components = doc["cmps"].to<JsonObject>();
 
-  for (const auto& entry : _app.getControllers()) {
-    entry.controller->haGenerateDiscoveryHook(components, ha_dev_uuid, this);
+  for (BaseController* c : _app.getHookSubscribers(YB_HOOK_HA_DISCOVERY)) {
+    c->haGenerateDiscoveryHook(components, ha_dev_uuid, this);
   }
 
   // dynamically allocate our buffer
@@ -355,7 +438,7 @@ void MQTTController::haDiscovery()
   }
 }
 
-void MQTTController::traverseJSON(JsonVariant node, const char* topic_prefix)
+void MQTTController::traverseJSON(JsonVariantConst node, const char* topic_prefix)
 {
   static constexpr size_t TOPIC_CAP = 256;
   char topicBuf[TOPIC_CAP] = "";
@@ -392,7 +475,7 @@ void MQTTController::append_index_to_topic(char* buf, size_t& len, size_t cap, s
 }
 
 // Convert a primitive JsonVariant to char* payload without String
-const char* MQTTController::to_payload(JsonVariant v, char* out, size_t outcap)
+const char* MQTTController::to_payload(JsonVariantConst v, char* out, size_t outcap)
 {
   if (v.isNull()) {
     // Publish literal "null"
@@ -473,14 +556,14 @@ const char* MQTTController::to_payload(JsonVariant v, char* out, size_t outcap)
 }
 
 // Depth-first traversal with an in-place topic buffer
-void MQTTController::traverse_impl(JsonVariant node, char* topicBuf, size_t cap, size_t curLen)
+void MQTTController::traverse_impl(JsonVariantConst node, char* topicBuf, size_t cap, size_t curLen)
 {
   // YBP.printf("traverse_impl: %s\n", topicBuf);
 
   // Objects
-  if (node.is<JsonObject>()) {
-    JsonObject obj = node.as<JsonObject>();
-    for (JsonPair kv : obj) { // ArduinoJson v7-compatible
+  if (node.is<JsonObjectConst>()) {
+    JsonObjectConst obj = node.as<JsonObjectConst>();
+    for (JsonPairConst kv : obj) { // ArduinoJson v7-compatible
       // Save current length so we can restore after recursion
       size_t savedLen = curLen;
 
@@ -498,10 +581,10 @@ void MQTTController::traverse_impl(JsonVariant node, char* topicBuf, size_t cap,
   }
 
   // Arrays
-  if (node.is<JsonArray>()) {
-    JsonArray arr = node.as<JsonArray>();
+  if (node.is<JsonArrayConst>()) {
+    JsonArrayConst arr = node.as<JsonArrayConst>();
     size_t idx = 0;
-    for (JsonVariant v : arr) {
+    for (JsonVariantConst v : arr) {
       size_t savedLen = curLen;
       append_index_to_topic(topicBuf, curLen, cap, idx++);
       traverse_impl(v, topicBuf, cap, curLen);
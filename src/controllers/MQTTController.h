@@ -18,6 +18,7 @@
 #include "controllers/ProtocolController.h"
 #include <ArduinoJson.h>
 #include <PsychicMqttClient.h>
+#include <atomic>
 
 class YarrboardApp;
 class ConfigManager;
@@ -36,19 +37,33 @@ class MQTTController : public BaseController
 
     void onTopic(const char* topic, int qos, OnMessageUserCallback callback);
     void publish(const char* topic, const char* payload, bool use_prefix = true);
-    void traverseJSON(JsonVariant node, const char* topic_prefix);
+    void publishResponse(JsonVariantConst output);
+    void traverseJSON(JsonVariantConst node, const char* topic_prefix);
 
     void handleSetMQTTConfig(JsonVariantConst input, JsonVariant output, ProtocolContext context);
     void generateStatsHook(JsonVariant output) override;
 
   private:
     PsychicMqttClient mqttClient;
-    unsigned long previousMQTTMillis = 0;
     bool _firstConnection = true;
 
     void haDiscovery();
     void receiveMessage(const char* topic, const char* payload, int retain, int qos, bool dup);
 
+    // set_mqtt_config runs on whatever task the command came in on, but only loop() touches
+    // the client.  the handler leaves a request (and its deferred reply token) for loop().
+    std::atomic<bool> _reconnectRequested{false};
+    std::atomic<uint32_t> _reconnectToken{0};
+
+    // main loop only
+    bool _reconnecting = false;
+    uint32_t _reconnectFor = 0; // token to answer, 0 = nobody
+    uint32_t _reconnectStarted = 0;
+    void startReconnect(uint32_t token);
+    void watchConnect(uint32_t token);
+    void checkReconnect();
+    void finishReconnect(const char* error);
+
     // our actual callbacks
     void onConnect(bool sessionPresent);
     void onDisconnect(bool sessionPresent);
@@ -65,8 +80,8 @@ class MQTTController : public BaseController
 
     void append_to_topic(char* buf, size_t& len, size_t cap, const char* piece);
     void append_index_to_topic(char* buf, size_t& len, size_t cap, size_t index);
-    const char* to_payload(JsonVariant v, char* out, size_t outcap);
-    void traverse_impl(JsonVariant node, char* topicBuf, size_t cap, size_t curLen);
+    const char* to_payload(JsonVariantConst v, char* out, size_t outcap);
+    void traverse_impl(JsonVariantConst node, char* topicBuf, size_t cap, size_t curLen);
 };
 
 #endif /* !YARR_MQTT_H */
\ No newline at end of file
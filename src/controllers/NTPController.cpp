@@ -17,6 +17,7 @@ NTPController* NTPController::_instance = nullptr;
 
 NTPController::NTPController(YarrboardApp& app) : BaseController(app, "ntp")
 {
+  setStartDependencies(YB_NEEDS_CONFIG | YB_NEEDS_NETWORK);
 }
 
 bool NTPController::setup()
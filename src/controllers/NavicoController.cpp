@@ -12,11 +12,15 @@
 
 #include "controllers/NavicoController.h"
 #include "ConfigManager.h"
+#include "JsonStream.h"
 #include "YarrboardDebug.h"
 
 NavicoController::NavicoController(YarrboardApp& app) : BaseController(app, "navico"),
                                                         MULTICAST_GROUP_IP(239, 2, 1, 1)
 {
+  // announce ourselves every 10 seconds
+  setLoopInterval(10000);
+  setStartDependencies(YB_NEEDS_CONFIG | YB_NEEDS_NETWORK);
 }
 
 // This code borrowed from the SignalK project:
@@ -27,63 +31,45 @@ void NavicoController::loop()
   String protocol;
   int port;
 
-  if (millis() - lastNavicoPublishMillis > 10000) {
-
-    if (!WiFi.isConnected())
-      return;
-
-    char urlBuf[48];
-    IPAddress ip = WiFi.localIP();
-    snprintf(urlBuf, sizeof(urlBuf), _cfg.app_enable_ssl ? "https://%u.%u.%u.%u:443" : "http://%u.%u.%u.%u:80", ip[0], ip[1], ip[2], ip[3]);
-    url = urlBuf; // assign once
-
-    // generate our config JSON
-    JsonDocument doc;
-
-    doc["Version"] = "1";
-    doc["Source"] = _cfg.board_name;
-    doc["IP"] = WiFi.localIP();
-    doc["FeatureName"] = String(_cfg.board_name) + " Webapp";
-
-    JsonObject Text_0 = doc["Text"].add<JsonObject>();
-    Text_0["Language"] = "en";
-    Text_0["Name"] = _cfg.board_name;
-    Text_0["Description"] = String(_cfg.board_name) + " Webapp";
-    doc["Icon"] = url + "/logo.png";
-    doc["URL"] = url + "/";
-    doc["OnlyShowOnClientIP"] = "true";
-
-    JsonObject BrowserPanel = doc["BrowserPanel"].to<JsonObject>();
-    BrowserPanel["Enable"] = true;
-    BrowserPanel["ProgressBarEnable"] = true;
-
-    JsonObject BrowserPanel_MenuText_0 = BrowserPanel["MenuText"].add<JsonObject>();
-    BrowserPanel_MenuText_0["Language"] = "en";
-    BrowserPanel_MenuText_0["Name"] = "Home";
-
-    // make our dynamic buffer for the output
-    size_t jsonSize = measureJson(doc);
-    char* jsonBuffer = (char*)malloc(jsonSize + 1);
-    if (!jsonBuffer) {
-      YBP.println("Navico malloc failed!");
-      return;
-    }
-
-    jsonBuffer[jsonSize] = '\0'; // null terminate
-
-    // did we get anything?
-    serializeJson(doc, jsonBuffer, jsonSize + 1);
-
-    if (Udp.beginPacket(MULTICAST_GROUP_IP, PUBLISH_PORT)) {
-      Udp.write((const uint8_t*)jsonBuffer, jsonSize);
-      Udp.endPacket();
-    } else {
-      YBP.println("UDP beginPacket failed");
-    }
-
-    free(jsonBuffer);
-
-    lastNavicoPublishMillis = millis();
+  if (!WiFi.isConnected())
+    return;
+
+  char urlBuf[48];
+  IPAddress ip = WiFi.localIP();
+  snprintf(urlBuf, sizeof(urlBuf), _cfg.app_enable_ssl ? "https://%u.%u.%u.%u:443" : "http://%u.%u.%u.%u:80", ip[0], ip[1], ip[2], ip[3]);
+  url = urlBuf; // assign once
+
+  // generate our config JSON
+  JsonDocument doc;
+
+  doc["Version"] = "1";
+  doc["Source"] = _cfg.board_name;
+  doc["IP"] = WiFi.localIP();
+  doc["FeatureName"] = String(_cfg.board_name) + " Webapp";
+
+  JsonObject Text_0 = doc["Text"].add<JsonObject>();
+  Text_0["Language"] = "en";
+  Text_0["Name"] = _cfg.board_name;
+  Text_0["Description"] = String(_cfg.board_name) + " Webapp";
+  doc["Icon"] = url + "/logo.png";
+  doc["URL"] = url + "/";
+  doc["OnlyShowOnClientIP"] = "true";
+
+  JsonObject BrowserPanel = doc["BrowserPanel"].to<JsonObject>();
+  BrowserPanel["Enable"] = true;
+  BrowserPanel["ProgressBarEnable"] = true;
+
+  JsonObject BrowserPanel_MenuText_0 = BrowserPanel["MenuText"].add<JsonObject>();
+  BrowserPanel_MenuText_0["Language"] = "en";
+  BrowserPanel_MenuText_0["Name"] = "Home";
+
+  // serialize straight into the packet
+  if (Udp.beginPacket(MULTICAST_GROUP_IP, PUBLISH_PORT)) {
+    PrintJsonStream stream(Udp);
+    stream.sendJson(doc);
+    Udp.endPacket();
+  } else {
+    YBP.println("UDP beginPacket failed");
   }
 }
 
@@ -29,7 +29,6 @@ class NavicoController : public BaseController
     bool setup() override;
 
   private:
-    unsigned long lastNavicoPublishMillis = 0;
     const int PUBLISH_PORT = 2053;
     IPAddress MULTICAST_GROUP_IP;
     WiFiUDP Udp;
@@ -21,6 +21,7 @@ NetworkController::NetworkController(YarrboardApp& app) : BaseController(app, "n
                                                           improvSerial(&Serial),
                                                           apIP(8, 8, 4, 4)
 {
+  setStartDependencies(YB_NEEDS_CONFIG);
 }
 
 bool NetworkController::setup()
@@ -46,10 +47,33 @@ void NetworkController::loop()
   if (_cfg.is_first_boot) {
     improvSerial.handleSerial();
   }
+
+  // waiting on our boot time wifi connection?
+  if (_connecting) {
+    int result = _checkWifi();
+    if (result > 0) {
+      _connecting = false;
+      startServices();
+    } else if (result < 0) {
+      _connecting = false;
+
+      // stay reachable so the settings can be fixed, rather than hanging here
+      YBP.println("[WiFi] Falling back to AP mode");
+      _fallbackAP = true;
+      _startAP(_cfg.local_hostname, _cfg.wifi_pass);
+      startServices();
+    }
+  }
+
+  // hold the boot button to go back to first boot (improv)
+  if (_fallbackAP)
+    _checkBootPress();
 }
 
 void NetworkController::setupWifi()
 {
+  _fallbackAP = false;
+
   // which mode do we want?
   if (!strcmp(_cfg.wifi_mode, "client")) {
     YBP.print("Client mode: ");
@@ -57,66 +81,83 @@ void NetworkController::setupWifi()
     YBP.print(" / ");
     YBP.println(_cfg.wifi_pass);
 
-    // try and connect
-    if (connectToWifi(_cfg.wifi_ssid, _cfg.wifi_pass))
-      startServices();
-    else
-      waitForBootPress();
+    // start connecting, loop() will take it from here.
+    _beginWifi(_cfg.wifi_ssid, _cfg.wifi_pass);
+    _connecting = true;
   }
   // default to AP mode.
   else {
-    YBP.print("AP mode: ");
-    YBP.print(_cfg.wifi_ssid);
-    YBP.print(" / ");
-    YBP.println(_cfg.wifi_pass);
+    _startAP(_cfg.wifi_ssid, _cfg.wifi_pass);
+
+    // nothing to wait for.
+    _ready = true;
+  }
+}
+
+void NetworkController::_startAP(const char* ssid, const char* pass)
+{
+  YBP.print("AP mode: ");
+  YBP.print(ssid);
+  YBP.print(" / ");
+  YBP.println(pass);
+
+  // softAP() wants no password or at least 8 characters
+  if (strlen(pass) < 8)
+    pass = nullptr;
+
+  WiFi.mode(WIFI_AP);
+  WiFi.softAP(ssid, pass);
+  WiFi.softAPConfig(apIP, apIP, IPAddress(255, 255, 255, 0));
+
+  YBP.print("AP IP address: ");
+  YBP.println(apIP);
+
+  // if DNSServer is started with "*" for domain name, it will reply with
+  // provided IP to all DNS request
+  dnsServer.start(DNS_PORT, "*", apIP);
+}
+
+void NetworkController::_checkBootPress()
+{
+  // Read the boot pin (LOW when pressed)
+  if (digitalRead(YB_BOOT_PIN) != LOW) {
+    _bootPressMillis = 0;
+    return;
+  }
 
-    WiFi.mode(WIFI_AP);
-    WiFi.softAP(_cfg.wifi_ssid, _cfg.wifi_pass);
-    WiFi.softAPConfig(apIP, apIP, IPAddress(255, 255, 255, 0));
+  // Button just pressed, record the time
+  if (!_bootPressMillis) {
+    _bootPressMillis = millis() | 1;
+    return;
+  }
 
-    YBP.print("AP IP address: ");
-    YBP.println(apIP);
+  // Button is being held, check if 5 seconds have elapsed
+  if (millis() - _bootPressMillis >= 5000) {
+    YBP.println("Boot button held for 5 seconds - resetting to first boot");
+    _cfg.is_first_boot = true;
 
-    // if DNSServer is started with "*" for domain name, it will reply with
-    // provided IP to all DNS request
-    dnsServer.start(DNS_PORT, "*", apIP);
+    char error[128];
+    _cfg.saveConfig(error, sizeof(error));
+    ESP.restart();
   }
 }
 
-void NetworkController::waitForBootPress()
+bool NetworkController::connectToWifi(const char* ssid, const char* pass)
 {
-  unsigned long pressStartTime = 0;
-  bool buttonPressed = false;
-
-  while (true) {
-    // Read the boot pin (LOW when pressed)
-    if (digitalRead(YB_BOOT_PIN) == LOW) {
-      if (!buttonPressed) {
-        // Button just pressed, record the time
-        buttonPressed = true;
-        pressStartTime = millis();
-      } else {
-        // Button is being held, check if 5 seconds have elapsed
-        if (millis() - pressStartTime >= 5000) {
-          YBP.println("Boot button held for 5 seconds - resetting to first boot");
-          _cfg.is_first_boot = true;
-
-          char error[128];
-          _cfg.saveConfig(error, sizeof(error));
-          ESP.restart();
-        }
-      }
-    } else {
-      // Button released, reset the tracking
-      buttonPressed = false;
-    }
+  _beginWifi(ssid, pass);
 
-    delay(100);
+  // attempt to connect
+  int result;
+  while ((result = _checkWifi()) == 0) {
+    YBP.print(".");
+    delay(50);
     yield();
   }
+
+  return result > 0;
 }
 
-bool NetworkController::connectToWifi(const char* ssid, const char* pass)
+void NetworkController::_beginWifi(const char* ssid, const char* pass)
 {
   _app.setStatusColor(CRGB::Yellow);
 
@@ -135,39 +176,39 @@ bool NetworkController::connectToWifi(const char* ssid, const char* pass)
   WiFi.setAutoReconnect(true);
   WiFi.setSleep(false); // optional but usually helps reliability
 
-  // How long to try for?
-  int tryDuration = 15000;
-  int tryDelay = 50;
-  int numberOfTries = tryDuration / tryDelay;
-
   YBP.print("[WiFi] Connecting to ");
   YBP.println(ssid);
   WiFi.begin(ssid, pass);
 
-  // attempt to connect
-  while (numberOfTries > 0) {
-    if (WiFi.status() == WL_CONNECTED) {
-      YBP.println("\n[WiFi] WiFi is connected!");
-      YBP.print("[WiFi] IP address: ");
-      YBP.println(WiFi.localIP());
-
-      _app.setStatusColor(CRGB::Green);
+  _connectStartMillis = millis();
+}
 
-      return true;
-    }
+// 1 = connected, -1 = gave up, 0 = still trying
+int NetworkController::_checkWifi()
+{
+  wl_status_t status = WiFi.status();
 
-    if (WiFi.status() == WL_NO_SSID_AVAIL) {
-      YBP.println("[WiFi] SSID not found");
-      break;
-    }
+  if (status == WL_CONNECTED) {
+    YBP.println("\n[WiFi] WiFi is connected!");
+    YBP.print("[WiFi] IP address: ");
+    YBP.println(WiFi.localIP());
 
-    YBP.print(".");
+    _app.setStatusColor(CRGB::Green);
 
-    numberOfTries--;
+    return 1;
+  }
 
-    delay(tryDelay);
-    yield();
+  bool failed = false;
+  if (status == WL_NO_SSID_AVAIL) {
+    YBP.println("[WiFi] SSID not found");
+    failed = true;
   }
+  // How long to try for?
+  else if (millis() - _connectStartMillis >= YB_WIFI_CONNECT_TIMEOUT_MS)
+    failed = true;
+
+  if (!failed)
+    return 0;
 
   YBP.println("\n[WiFi] WiFi failed to connect");
   WiFi.setAutoReconnect(false); // Stop auto-reconnect attempts
@@ -176,7 +217,7 @@ bool NetworkController::connectToWifi(const char* ssid, const char* pass)
 
   _app.setStatusColor(CRGB::Red);
 
-  return false;
+  return -1;
 }
 
 void NetworkController::startServices()
@@ -192,6 +233,9 @@ void NetworkController::startServices()
   if (!MDNS.begin(_cfg.local_hostname))
     YBP.println("Error starting mDNS");
   MDNS.addService("http", "tcp", 80);
+
+  // network dependent controllers can start now
+  _ready = true;
 }
 
 void NetworkController::setupImprov()
@@ -38,8 +38,18 @@ class NetworkController : public BaseController
 
     void setupWifi();
     bool connectToWifi(const char* ssid, const char* pass);
+
+    // non blocking version: begin, then poll until it returns 1 (connected) or -1 (failed)
+    void beginConnect(const char* ssid, const char* pass) { _beginWifi(ssid, pass); }
+    int checkConnect() { return _checkWifi(); }
     void startServices();
 
+    // true once we're connected (or in AP mode) and services are up
+    bool isReady() { return _ready; }
+
+    // client mode couldn't connect at boot, so we're running our own AP instead
+    bool isFallbackAP() { return _fallbackAP; }
+
     IPAddress apIP;
     bool improvDone = false;
 
@@ -60,7 +70,16 @@ class NetworkController : public BaseController
     // We use a static instance pointer and static methods to bridge the gap.
     static NetworkController* _instance;
 
-    void waitForBootPress();
+    bool _ready = false;
+    bool _connecting = false;
+    bool _fallbackAP = false;
+    unsigned long _connectStartMillis = 0;
+    unsigned long _bootPressMillis = 0; // 0 = not held
+
+    void _startAP(const char* ssid, const char* pass);
+    void _checkBootPress();
+    void _beginWifi(const char* ssid, const char* pass);
+    int _checkWifi();
 
     static void _onImprovErrorStatic(ImprovTypes::Error err);
     static void _onImprovConnectedStatic(const char* ssid, const char* password);
@@ -19,14 +19,16 @@ OTAController* OTAController::_instance = nullptr;
 
 OTAController::OTAController(YarrboardApp& app) : BaseController(app, "ota")
 {
+  setStartDependencies(YB_NEEDS_CONFIG | YB_NEEDS_NETWORK);
+
+  // registered now so the command list is done before http starts serving.  setup() waits on the network.
+  _app.protocol.registerCommand(ADMIN, "ota_start", this, &OTAController::handleOTAStart, "");
 }
 
 bool OTAController::setup()
 {
   _instance = this; // Capture the instance for callbacks
 
-  _app.protocol.registerCommand(ADMIN, "ota_start", this, &OTAController::handleOTAStart);
-
   if (_cfg.app_enable_ota) {
     ArduinoOTA.setHostname(_cfg.local_hostname);
     ArduinoOTA.setPort(3232);
@@ -72,10 +74,22 @@ void OTAController::loop()
 
 void OTAController::handleOTAStart(JsonVariantConst input, JsonVariant output, ProtocolContext context)
 {
-  if (_app.ota.checkOTA())
-    _app.ota.startOTA();
+  // no network yet, or no wifi at all
+  if (FOTA == nullptr)
+    return _app.protocol.generateErrorJSON(output, "OTA is not available.");
+
+  // checking the manifest is an https request, so it runs in the worker
+  ProtocolController::DeferredWork work = ProtocolController::DeferredWork::create<OTAController, &OTAController::checkDeferred>(*this);
+  if (!_app.protocol.deferToWorker(output, context, work))
+    return _app.protocol.generateErrorJSON(output, "Too many pending commands, try again.");
+}
+
+void OTAController::checkDeferred(JsonVariant result)
+{
+  if (checkOTA())
+    startOTA();
   else
-    return _app.protocol.generateErrorJSON(output, "Firmware already up to date.");
+    _app.protocol.generateErrorJSON(result, "Firmware already up to date.");
 }
 
 void OTAController::end()
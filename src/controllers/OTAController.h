@@ -41,10 +41,9 @@ class OTAController : public BaseController
     const char* public_key = "";
 
   private:
-    esp32FOTA*
-      FOTA;
+    esp32FOTA* FOTA = nullptr;
 
-    CryptoMemAsset* MyPubKey;
+    CryptoMemAsset* MyPubKey = nullptr;
     bool doOTAUpdate = false;
     unsigned long ota_last_message = 0;
 
@@ -63,6 +62,7 @@ class OTAController : public BaseController
     void _updateCheckFailCallback(int partition, int error_code);
 
     void handleOTAStart(JsonVariantConst input, JsonVariant output, ProtocolContext context);
+    void checkDeferred(JsonVariant result);
     void sendOTAProgressUpdate(float progress);
     void sendOTAProgressFinished();
 };
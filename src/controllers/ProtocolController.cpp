@@ -14,104 +14,304 @@
 #include "ConfigManager.h"
 #include "YarrboardApp.h"
 #include "YarrboardDebug.h"
+#include "channels/BaseChannel.h"
 #include "controllers/OTAController.h"
 #include "utility.h"
 
 ProtocolController::ProtocolController(YarrboardApp& app) : BaseController(app, "protocol")
 {
+  setStartDependencies(YB_NEEDS_CONFIG);
+
+  // before setup(), controllers register commands from their constructors and setup()s
+  commandMutex = xSemaphoreCreateMutexStatic(&commandMutexBuffer);
 }
 
 bool ProtocolController::setup()
 {
-  registerCommand(NOBODY, "ping", this, &ProtocolController::handlePing);
-  registerCommand(NOBODY, "hello", this, &ProtocolController::handleHello);
-  registerCommand(NOBODY, "login", this, &ProtocolController::handleLogin);
-  registerCommand(NOBODY, "logout", this, &ProtocolController::handleLogout);
-
-  registerCommand(GUEST, "get_config", this, &ProtocolController::handleGetConfig);
-  registerCommand(GUEST, "get_stats", this, &ProtocolController::handleGetStats);
-  registerCommand(GUEST, "get_update", this, &ProtocolController::handleGetUpdate);
-  registerCommand(GUEST, "set_theme", this, &ProtocolController::handleSetTheme);
-  registerCommand(GUEST, "set_brightness", this, &ProtocolController::handleSetBrightness);
-
-  registerCommand(ADMIN, "set_general_config", this, &ProtocolController::handleSetGeneralConfig);
-  registerCommand(ADMIN, "save_config", this, &ProtocolController::handleSaveConfig);
-  registerCommand(ADMIN, "get_full_config", this, &ProtocolController::handleGetFullConfig);
-  registerCommand(ADMIN, "get_network_config", this, &ProtocolController::handleGetNetworkConfig);
-  registerCommand(ADMIN, "get_app_config", this, &ProtocolController::handleGetAppConfig);
-  registerCommand(ADMIN, "set_network_config", this, &ProtocolController::handleSetNetworkConfig);
-  registerCommand(ADMIN, "set_authentication_config", this, &ProtocolController::handleSetAuthenticationConfig);
-  registerCommand(ADMIN, "set_webserver_config", this, &ProtocolController::handleSetWebServerConfig);
-  registerCommand(ADMIN, "set_misc_config", this, &ProtocolController::handleSetMiscellaneousConfig);
-  registerCommand(ADMIN, "restart", this, &ProtocolController::handleRestart);
-  registerCommand(ADMIN, "factory_reset", this, &ProtocolController::handleFactoryReset);
+  updateMutex = xSemaphoreCreateMutex();
+  if (updateMutex == NULL) {
+    YBP.println("Failed to create update mutex");
+    return false;
+  }
+
+  rateMutex = xSemaphoreCreateMutex();
+  if (rateMutex == NULL) {
+    YBP.println("Failed to create rate limit mutex");
+    return false;
+  }
+
+  deferredMutex = xSemaphoreCreateMutex();
+  if (deferredMutex == NULL) {
+    YBP.println("Failed to create deferred reply mutex");
+    return false;
+  }
+
+  // slow handlers (network checks, etc) run here instead of in the loop
+  deferredJobs = xQueueCreate(YB_PROTOCOL_MAX_DEFERRED, sizeof(DeferredJob));
+  if (deferredJobs == 0) {
+    YBP.println("Failed to create deferred job queue");
+    return false;
+  }
+
+  if (xTaskCreate(deferredWorkerTask, "yb_deferred", YB_PROTOCOL_DEFERRED_STACK_SIZE, this, 1, &deferredWorker) != pdPASS) {
+    YBP.println("Failed to create deferred worker task");
+    return false;
+  }
+
+  registerCommand(NOBODY, "ping", this, &ProtocolController::handlePing, "");
+  registerCommand(NOBODY, "hello", this, &ProtocolController::handleHello, "encoding,framing");
+  registerCommand(NOBODY, "login", this, &ProtocolController::handleLogin, "");
+  registerCommand(NOBODY, "logout", this, &ProtocolController::handleLogout, "");
+
+  registerCommand(GUEST, "get_config", this, &ProtocolController::handleGetConfig, "");
+  registerCommand(GUEST, "get_stats", this, &ProtocolController::handleGetStats, "");
+  registerCommand(GUEST, "get_command_stats", this, &ProtocolController::handleGetCommandStats, "reset");
+  registerCommand(GUEST, "get_deferred", this, &ProtocolController::handleGetDeferred, "token");
+  registerCommand(GUEST, "get_update", this, &ProtocolController::handleGetUpdate, "since");
+  registerCommand(GUEST, "subscribe", this, &ProtocolController::handleSubscribe, "controller,channel");
+  registerCommand(GUEST, "unsubscribe", this, &ProtocolController::handleUnsubscribe, "controller,channel");
+  registerCommand(GUEST, "set_theme", this, &ProtocolController::handleSetTheme, "theme");
+  registerCommand(GUEST, "set_brightness", this, &ProtocolController::handleSetBrightness, "brightness");
+
+  registerCommand(ADMIN, "set_general_config", this, &ProtocolController::handleSetGeneralConfig, "board_name,startup_melody");
+  registerCommand(ADMIN, "save_config", this, &ProtocolController::handleSaveConfig, "config");
+  registerCommand(ADMIN, "get_full_config", this, &ProtocolController::handleGetFullConfig, "");
+  registerCommand(ADMIN, "get_network_config", this, &ProtocolController::handleGetNetworkConfig, "");
+  registerCommand(ADMIN, "get_app_config", this, &ProtocolController::handleGetAppConfig, "");
+  registerCommand(ADMIN, "set_network_config", this, &ProtocolController::handleSetNetworkConfig, "wifi_mode,wifi_ssid,wifi_pass,local_hostname");
+  registerCommand(ADMIN, "set_authentication_config", this, &ProtocolController::handleSetAuthenticationConfig, "admin_user,admin_pass,guest_user,guest_pass,default_role");
+  registerCommand(ADMIN, "set_webserver_config", this, &ProtocolController::handleSetWebServerConfig, "app_enable_mfd,app_enable_api,app_enable_ssl,server_cert,server_key");
+  registerCommand(ADMIN, "set_misc_config", this, &ProtocolController::handleSetMiscellaneousConfig, "app_enable_serial,app_enable_ota");
+  registerCommand(ADMIN, "restart", this, &ProtocolController::handleRestart, "");
+  registerCommand(ADMIN, "factory_reset", this, &ProtocolController::handleFactoryReset, "");
+
+  // the expensive ones cost more against the rate limit
+  setCommandWeight("get_full_config", 4);
+  setCommandWeight("get_command_stats", 4);
+  setCommandWeight("get_stats", 2);
+  setCommandWeight("save_config", 4);
+
+  // forget subscriptions when their client goes away
+  _app.events.subscribe(YB_EVENT_CLIENT_DISCONNECTED,
+    EventBus::Handler::create<ProtocolController, &ProtocolController::onClientDisconnected>(*this));
 
   return true;
 }
 
 void ProtocolController::loop()
 {
+  // commands changed?  only rebuild from the main loop.
+  if (commandTableDirty)
+    buildCommandTable();
+
   // lookup our info periodically
-  unsigned int messageDelta = millis() - previousMessageMillis;
+  uint32_t now = _app.frame().now_ms;
+  unsigned int messageDelta = now - previousMessageMillis;
   if (messageDelta >= 1000) {
 
     // for keeping track.
-    receivedMessagesPerSecond = receivedMessages;
-    receivedMessages = 0;
-    sentMessagesPerSecond = sentMessages;
-    sentMessages = 0;
+    receivedMessagesPerSecond = receivedMessages.exchange(0);
+    sentMessagesPerSecond = sentMessages.exchange(0);
 
-    previousMessageMillis = millis();
+    previousMessageMillis = now;
   }
 
   // check to see if we need to send one.
   bool doFastUpdate = false;
-  for (const auto& entry : _app.getControllers()) {
-    if (entry.controller->needsFastUpdate()) {
+  for (BaseController* c : _app.getHookSubscribers(YB_HOOK_FAST_UPDATE)) {
+    if (c->needsFastUpdate() && wantsController(c)) {
       doFastUpdate = true;
       break;
     }
   }
 
-  if (doFastUpdate)
-    sendFastUpdate();
+  if (doFastUpdate) {
+    if (!fastUpdatePending) {
+      fastUpdatePending = true;
+      fastUpdatePendingSince = now;
+    }
 
-  // any serial port customers?
-  if (_cfg.app_enable_serial) {
-    if (Serial.available() > 0)
-      handleSerialJson();
+    // give other changes a chance to pile in, and stay under our max rate
+    uint32_t minInterval = fast_update_max_rate ? 1000 / fast_update_max_rate : 0;
+    bool windowOpen = now - fastUpdatePendingSince < fast_update_window_ms;
+    bool tooSoon = now - lastFastUpdateMillis < minInterval;
+
+    if (!windowOpen && !tooSoon) {
+      sendFastUpdate();
+      fastUpdatesSent++;
+      lastFastUpdateMillis = now;
+      fastUpdatePending = false;
+      fastUpdateThrottled = false;
+    } else if (!windowOpen && !fastUpdateThrottled) {
+      fastUpdatesThrottled++;
+      fastUpdateThrottled = true;
+    }
+  } else {
+    fastUpdatePending = false;
+    fastUpdateThrottled = false;
   }
+
+  // any serial port customers?  partial frames wait in the framer until the rest shows up.
+  if (_cfg.app_enable_serial)
+    handleSerialJson();
+
+  // finish up anything that was put off
+  checkPendingWifi();
+  deliverDeferred();
+}
+
+bool ProtocolController::lockCommands()
+{
+  // constructors register commands before the scheduler starts, there's nobody to race yet
+  if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)
+    return false;
+
+  xSemaphoreTake(commandMutex, portMAX_DELAY);
+  return true;
+}
+
+void ProtocolController::unlockCommands(bool locked)
+{
+  if (locked)
+    xSemaphoreGive(commandMutex);
 }
 
-bool ProtocolController::registerCommand(UserRole role, const char* command, ProtocolMessageHandler handler)
+bool ProtocolController::registerCommand(UserRole role, const char* command, ProtocolMessageHandler handler, const char* fields)
 {
-  if (commandMap.full()) {
+  bool locked = lockCommands();
+
+  CommandEntry* existing = findCommand(command);
+  if (existing) {
+    existing->role = role;
+    existing->handler = handler;
+    existing->fields = fields;
+    unlockCommands(locked);
+    YBP.printf("⚠️ Warning: Overwriting protocol command '%s'\n", command);
+    return true;
+  }
+
+  if (commands.full()) {
+    unlockCommands(locked);
     YBP.printf("❌ Error: Protocol command list is full. (%s)\n", command);
     return false;
   }
 
-  if (hasCommand(command))
-    YBP.printf("⚠️ Warning: Overwriting protocol command '%s'\n", command);
+  // reads go in the poll lane, anything that changes something jumps ahead of them
+  bool poll = !strncmp(command, "get_", 4) || !strcmp(command, "ping");
 
-  commandMap[command] = {role, handler};
+  commands.push_back({command, role, handler, poll ? YB_LANE_POLL : YB_LANE_CONTROL, 1, fields});
+  commandTableDirty = true;
+  unlockCommands(locked);
   return true;
 }
 
+bool ProtocolController::setCommandWeight(const char* command, uint8_t weight)
+{
+  bool locked = lockCommands();
+  CommandEntry* entry = findCommand(command);
+  if (entry)
+    entry->weight = weight;
+  unlockCommands(locked);
+
+  return entry != nullptr;
+}
+
+bool ProtocolController::setCommandLane(const char* command, YBLane lane)
+{
+  if (lane >= YB_LANE_COUNT)
+    return false;
+
+  bool locked = lockCommands();
+  CommandEntry* entry = findCommand(command);
+  if (entry)
+    entry->lane = lane;
+  unlockCommands(locked);
+
+  return entry != nullptr;
+}
+
+YBLane ProtocolController::getCommandLane(const char* command)
+{
+  // can't tell what it is, so it waits with the polls
+  if (command == nullptr)
+    return YB_LANE_POLL;
+
+  bool locked = lockCommands();
+  CommandEntry* entry = findCommand(command);
+  YBLane lane = entry != nullptr ? entry->lane : YB_LANE_POLL;
+  unlockCommands(locked);
+
+  return lane;
+}
+
+const char* ProtocolController::getLaneName(YBLane lane)
+{
+  return lane == YB_LANE_CONTROL ? "control" : "poll";
+}
+
 bool ProtocolController::unregisterCommand(const char* command)
 {
-  return commandMap.erase(command) > 0;
+  bool locked = lockCommands();
+  CommandEntry* entry = findCommand(command);
+  if (entry) {
+    // indexes after it shift, so lookups go the slow way until loop() rebuilds the table
+    commandTableDirty = true;
+    commands.erase(entry);
+  }
+  unlockCommands(locked);
+
+  return entry != nullptr;
 }
 
 bool ProtocolController::hasCommand(const char* command)
 {
-  return commandMap.find(command) != commandMap.end();
+  bool locked = lockCommands();
+  bool found = findCommand(command) != nullptr;
+  unlockCommands(locked);
+
+  return found;
 }
 
 void ProtocolController::printCommands()
 {
+  bool locked = lockCommands();
   YBP.println("Protocol Commands:");
-  for (const auto& kvp : commandMap)
-    YBP.printf("%-6s | %s\n", _app.auth.getRoleText(kvp.second.role), kvp.first);
+  for (const auto& entry : commands)
+    YBP.printf("%-6s | %s\n", _app.auth.getRoleText(entry.role), entry.command);
+  unlockCommands(locked);
+}
+
+uint32_t ProtocolController::hashCommand(const char* command, uint32_t seed)
+{
+  return CommandTable<YB_PROTOCOL_HASH_SIZE>::hash(command, seed);
+}
+
+void ProtocolController::buildCommandTable()
+{
+  static_assert(YB_PROTOCOL_HASH_SIZE >= YB_PROTOCOL_MAX_COMMANDS * 2, "YB_PROTOCOL_HASH_SIZE is too small");
+
+  bool locked = lockCommands();
+  commandTable.rebuild(commands);
+  commandTableDirty = false;
+  unlockCommands(locked);
+}
+
+ProtocolController::CommandEntry* ProtocolController::findCommand(const char* command)
+{
+  if (command == nullptr)
+    return nullptr;
+
+  // table is stale until loop() rebuilds it, do it the slow way.
+  if (commandTableDirty) {
+    for (auto& entry : commands) {
+      if (!strcmp(entry.command, command))
+        return &entry;
+    }
+    return nullptr;
+  }
+
+  int index = commandTable.find(commands, command);
+  return index >= 0 ? &commands[index] : nullptr;
 }
 
 void ProtocolController::incrementSentMessages()
@@ -121,36 +321,379 @@ void ProtocolController::incrementSentMessages()
   totalSentMessages++;
 }
 
+const char* ProtocolController::rateLimitedJSON = "{\"msg\":\"status\",\"status\":\"error\",\"message\":\"Rate limited\"}";
+
+YBAdmit ProtocolController::admitMessage(YBMode mode, uint32_t clientId, const char* data, size_t len, bool binary)
+{
+  char cmd[YB_PROTOCOL_MAX_COMMAND_LENGTH];
+  uint8_t count = data != nullptr ? scanCommand(data, len, binary, cmd, sizeof(cmd)) : 0;
+
+  return admitCommand(mode, clientId, count ? cmd : nullptr, count);
+}
+
+YBAdmit ProtocolController::admitCommand(YBMode mode, uint32_t clientId, const char* cmd, uint8_t count)
+{
+  if (rateMutex == NULL || mode > YBP_MODE_MQTT)
+    return YB_ADMIT_OK;
+
+  // figure out the cost before we take the lock
+  uint32_t cost = commandWeight(cmd, count);
+  uint32_t now = millis();
+
+  if (xSemaphoreTake(rateMutex, pdMS_TO_TICKS(10)) != pdTRUE)
+    return YB_ADMIT_OK;
+
+  RateTransport& transport = rateTransports[mode];
+  transport.bucket.configure(rate_limit_transport_rate, rate_limit_transport_burst);
+
+  RateClient* client = findRateClient(mode, clientId, now);
+  if (client != nullptr)
+    client->bucket.configure(rate_limit_client_rate, rate_limit_client_burst);
+
+  // both have to say yes before either one gets charged
+  bool ok = transport.bucket.has(cost, now) && (client == nullptr || client->bucket.has(cost, now));
+  if (ok) {
+    transport.bucket.take(cost);
+    if (client != nullptr) {
+      client->bucket.take(cost);
+      client->limited = false;
+    }
+  } else {
+    transport.dropped++;
+    if (client != nullptr)
+      client->dropped++;
+  }
+
+  // only the first drop in a row gets a reply, a flood shouldn't get a flood back
+  YBAdmit result = YB_ADMIT_OK;
+  if (!ok) {
+    result = (client != nullptr && client->limited) ? YB_ADMIT_DROP : YB_ADMIT_REJECT;
+    if (client != nullptr)
+      client->limited = true;
+  }
+
+  xSemaphoreGive(rateMutex);
+
+  return result;
+}
+
+ProtocolController::RateClient* ProtocolController::findRateClient(YBMode mode, uint32_t id, uint32_t now)
+{
+  RateClient* oldest = nullptr;
+  for (auto& c : rateClients) {
+    if (c.mode == mode && c.id == id) {
+      c.lastSeen = now;
+      return &c;
+    }
+
+    if (oldest == nullptr || (int32_t)(c.lastSeen - oldest->lastSeen) < 0)
+      oldest = &c;
+  }
+
+  // recycle whoever we heard from longest ago
+  if (rateClients.full()) {
+    if (oldest == nullptr)
+      return nullptr;
+    *oldest = RateClient();
+  } else {
+    rateClients.push_back(RateClient());
+    oldest = &rateClients.back();
+  }
+
+  oldest->mode = mode;
+  oldest->id = id;
+  oldest->lastSeen = now;
+  return oldest;
+}
+
+void ProtocolController::removeRateClient(YBMode mode, uint32_t id)
+{
+  if (rateMutex == NULL || xSemaphoreTake(rateMutex, portMAX_DELAY) != pdTRUE)
+    return;
+
+  for (auto it = rateClients.begin(); it != rateClients.end(); ++it) {
+    if (it->mode == mode && it->id == id) {
+      rateClients.erase(it);
+      break;
+    }
+  }
+
+  xSemaphoreGive(rateMutex);
+}
+
+uint32_t ProtocolController::commandWeight(const char* cmd, uint8_t count)
+{
+  if (cmd == nullptr || count == 0)
+    return 1;
+
+  bool locked = lockCommands();
+  CommandEntry* entry = findCommand(cmd);
+  uint32_t weight = entry != nullptr ? entry->weight : 1;
+  unlockCommands(locked);
+
+  // batches pay for every command in them, at the first one's price
+  return weight * count;
+}
+
+uint8_t ProtocolController::scanCommand(const char* data, size_t len, bool binary, char* cmd, size_t cmdSize)
+{
+  uint8_t count = 0;
+  cmd[0] = '\0';
+
+  // msgpack: fixstr "cmd", then a fixstr or str8 value
+  if (binary) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i + 4 < len; i++) {
+      if (p[i] != 0xA3 || memcmp(p + i + 1, "cmd", 3))
+        continue;
+
+      if (count++ == 0) {
+        size_t at = i + 4;
+        size_t n = 0;
+        if ((p[at] & 0xE0) == 0xA0)
+          n = p[at++] & 0x1F;
+        else if (p[at] == 0xD9 && at + 1 < len)
+          n = p[++at], at++;
+
+        if (n < cmdSize && at + n <= len) {
+          memcpy(cmd, p + at, n);
+          cmd[n] = '\0';
+        }
+      }
+      i += 3;
+    }
+
+    return count;
+  }
+
+  // json: "cmd" : "value"
+  for (size_t i = 0; i + 5 < len; i++) {
+    if (data[i] != '"' || memcmp(data + i + 1, "cmd\"", 4))
+      continue;
+
+    if (count++ == 0) {
+      size_t at = i + 5;
+      while (at < len && (isspace(data[at]) || data[at] == ':'))
+        at++;
+
+      if (at < len && data[at] == '"') {
+        size_t start = ++at;
+        while (at < len && data[at] != '"' && at - start < cmdSize - 1)
+          at++;
+
+        if (at < len && data[at] == '"') {
+          memcpy(cmd, data + start, at - start);
+          cmd[at - start] = '\0';
+        }
+      }
+    }
+    i += 4;
+  }
+
+  return count;
+}
+
+DeserializationError ProtocolController::parseMessage(JsonDocument& input, const char* data, size_t len, bool binary)
+{
+  char cmd[YB_PROTOCOL_MAX_COMMAND_LENGTH];
+  uint8_t count = scanCommand(data, len, binary, cmd, sizeof(cmd));
+
+  // is it a batch?  first byte past any whitespace.
+  bool batch;
+  if (binary) {
+    uint8_t first = len ? (uint8_t)data[0] : 0;
+    batch = (first & 0xF0) == 0x90 || first == 0xDC || first == 0xDD;
+  } else {
+    size_t i = 0;
+    while (i < len && isspace(data[i]))
+      i++;
+    batch = i < len && data[i] == '[';
+  }
+
+  // a batch of one still gets filtered, bigger ones could need anything
+  JsonDocument filter;
+  if (count == 1 && buildFilter(cmd, batch, filter)) {
+    DeserializationError err;
+    if (binary)
+      err = deserializeMsgPack(input, data, len, DeserializationOption::Filter(filter));
+    else
+      err = deserializeJson(input, data, len, DeserializationOption::Filter(filter));
+
+    if (err)
+      return err;
+
+    // the scan can be fooled by a nested "cmd", so make sure we filtered for the right one
+    JsonVariantConst command = batch ? input[0].as<JsonVariantConst>() : input.as<JsonVariantConst>();
+    if (command["cmd"] == cmd) {
+      filteredMessages++;
+      return err;
+    }
+
+    input.clear();
+  }
+
+  if (binary)
+    return deserializeMsgPack(input, data, len);
+  else
+    return deserializeJson(input, data, len);
+}
+
+bool ProtocolController::buildFilter(const char* cmd, bool batch, JsonDocument& filter)
+{
+  // no list means the handler wants everything.
+  // unknown commands just get an error back, so they don't need anything.
+  bool locked = lockCommands();
+  CommandEntry* entry = findCommand(cmd);
+  bool known = entry != nullptr;
+  const char* fields = known ? entry->fields : nullptr;
+  unlockCommands(locked);
+
+  if (known && fields == nullptr)
+    return false;
+
+  JsonObject f = batch ? filter.add<JsonObject>() : filter.to<JsonObject>();
+
+  // runCommand and auth need these
+  f["cmd"] = true;
+  f["msgid"] = true;
+  f["user"] = true;
+  f["pass"] = true;
+
+  if (!known)
+    return true;
+
+  // comma separated, copied out one at a time so the filter has its own copy
+  const char* p = fields;
+  while (*p) {
+    const char* comma = strchr(p, ',');
+    size_t n = comma ? comma - p : strlen(p);
+
+    char key[YB_PROTOCOL_MAX_FIELD_LENGTH];
+    if (n && n < sizeof(key)) {
+      memcpy(key, p, n);
+      key[n] = '\0';
+      f[key] = true;
+    }
+
+    p += n;
+    if (*p == ',')
+      p++;
+  }
+
+  return true;
+}
+
+const char* ProtocolController::getModeName(YBMode mode)
+{
+  switch (mode) {
+    case YBP_MODE_WEBSOCKET:
+      return "websocket";
+    case YBP_MODE_HTTP:
+      return "http";
+    case YBP_MODE_SERIAL:
+      return "serial";
+    case YBP_MODE_MQTT:
+      return "mqtt";
+    default:
+      return "none";
+  }
+}
+
 void ProtocolController::handleSerialJson()
 {
+  // only whole frames, and only a few per pass
+  uint8_t handled = 0;
+  while (serialFramer.poll()) {
+    if (handled++ == YB_SERIAL_MAX_FRAMES_PER_LOOP) {
+      _app.wakeLoop();
+      return;
+    }
+
+    handleSerialFrame(serialFramer.frame(), serialFramer.frameLength());
+    serialFramer.consume();
+  }
+}
+
+void ProtocolController::handleSerialFrame(const char* data, size_t len)
+{
+  // json always starts with a bracket, anything else in a cobs frame is msgpack
+  bool binary = serialFramer.getFraming() == YB_SERIAL_FRAMING_COBS && data[0] != '{' && data[0] != '[';
+
+  YBAdmit admit = admitMessage(YBP_MODE_SERIAL, 0, data, len, binary);
+  if (admit != YB_ADMIT_OK) {
+    if (admit == YB_ADMIT_REJECT)
+      serialFramer.writeFrame(rateLimitedJSON, strlen(rateLimitedJSON));
+    return;
+  }
+
   JsonDocument input;
-  DeserializationError err = deserializeJson(input, Serial);
   JsonDocument output;
+  DeserializationError err = parseMessage(input, data, len, binary);
 
-  // ignore newlines with serial.
   if (err) {
-    if (strcmp(err.c_str(), "EmptyInput")) {
-      char error[64];
-      sprintf(error, "deserializeJson() failed with code %s", err.c_str());
-      generateErrorJSON(output, error);
-      serializeJson(output, Serial);
-    }
+    char error[64];
+    sprintf(error, "%s() failed with code %s", binary ? "deserializeMsgPack" : "deserializeJson", err.c_str());
+    generateErrorJSON(output, error);
+    serialFramer.writeFrame(output);
   } else {
     ProtocolContext context;
     context.mode = YBP_MODE_SERIAL;
+    context.encoding = binary ? YB_ENCODING_MSGPACK : YB_ENCODING_JSON;
     handleReceivedJSON(input, output, context);
 
     // we can have empty responses
     if (output.size()) {
-      serializeJson(output, Serial);
+      serialFramer.writeFrame(output, binary);
 
       sentMessages++;
       totalSentMessages++;
     }
   }
+
+  // hello can switch framing, but its own reply goes out the old way
+  if (serialFramingNext != serialFramer.getFraming())
+    serialFramer.setFraming(serialFramingNext);
 }
 
 void ProtocolController::handleReceivedJSON(JsonVariantConst input, JsonVariant output, ProtocolContext context)
+{
+  // several commands in one go?
+  if (input.is<JsonArrayConst>())
+    return handleBatch(input.as<JsonArrayConst>(), output, context);
+
+  // what would you say you do around here?
+  context.role = _app.auth.getUserRole(input, context.mode, context.clientId);
+
+  runCommand(input, output, context);
+}
+
+void ProtocolController::handleBatch(JsonArrayConst input, JsonVariant output, ProtocolContext context)
+{
+  if (input.size() == 0)
+    return generateErrorJSON(output, "Empty command batch.");
+
+  if (input.size() > YB_PROTOCOL_MAX_BATCH) {
+    char error[64];
+    snprintf(error, sizeof(error), "Maximum batch size is %d commands.", YB_PROTOCOL_MAX_BATCH);
+    return generateErrorJSON(output, error);
+  }
+
+  // one auth lookup for the whole batch.  credentials (if any) go in the first command.
+  context.role = _app.auth.getUserRole(input[0], context.mode, context.clientId);
+
+  // run them in order, replies are matched up by msgid
+  JsonArray responses = output.to<JsonArray>();
+  for (JsonVariantConst command : input) {
+    JsonObject response = responses.add<JsonObject>();
+    runCommand(command, response, context);
+
+    // no news is good news
+    if (!response.size())
+      responses.remove(responses.size() - 1);
+  }
+}
+
+void ProtocolController::runCommand(JsonVariantConst input, JsonVariant output, ProtocolContext context)
 {
   // make sure its correct
   if (!input["cmd"].is<String>())
@@ -170,25 +713,45 @@ void ProtocolController::handleReceivedJSON(JsonVariantConst input, JsonVariant
   receivedMessages++;
   totalReceivedMessages++;
 
-  // what would you say you do around here?
-  context.role = _app.auth.getUserRole(input, context.mode, context.clientId);
-
-  // Try to find the command in the new map system
-  auto it = commandMap.find(cmd);
+  // Try to find the command in our table.  copy it out, it can be (un)registered while the handler runs.
+  bool locked = lockCommands();
+  CommandEntry* entry = findCommand(cmd);
+  bool found = entry != nullptr;
+  UserRole role = found ? entry->role : NOBODY;
+  ProtocolMessageHandler handler = found ? entry->handler : ProtocolMessageHandler();
+  unlockCommands(locked);
 
   // If FOUND, process it here and return.
-  // If NOT found, skip this block and let the legacy code handle it.
-  if (it != commandMap.end()) {
+  if (found) {
 
     // We found the command, so we must enforce auth.
-    if (!_app.auth.hasPermission(it->second.role, context.role)) {
+    if (!_app.auth.hasPermission(role, context.role)) {
       String error = "Unauthorized for " + String(cmd);
       return generateErrorJSON(output, error.c_str());
     }
 
     // Execute Handler
-    if (it->second.handler) {
-      it->second.handler(input, output, context);
+    if (handler) {
+      int64_t start = esp_timer_get_time();
+      handler(input, output, context);
+      uint32_t elapsed = esp_timer_get_time() - start;
+      bool error = output["status"] == "error";
+
+      // look it up again, our entry may have moved
+      locked = lockCommands();
+      entry = findCommand(cmd);
+      if (entry) {
+        entry->latency.add(elapsed);
+        entry->calls++;
+        if (error)
+          entry->errors++;
+      }
+      unlockCommands(locked);
+
+      // http has to answer on this request, so it waits here in the server task, not in our loop
+      if (context.mode == YBP_MODE_HTTP && output["status"] == "pending")
+        waitDeferred(output["token"].as<uint32_t>(), output);
+
       return;
     }
   }
@@ -198,9 +761,359 @@ void ProtocolController::handleReceivedJSON(JsonVariantConst input, JsonVariant
   return generateErrorJSON(output, error.c_str());
 }
 
+uint32_t ProtocolController::deferReply(JsonVariant output, ProtocolContext context)
+{
+  if (deferredMutex == NULL || xSemaphoreTake(deferredMutex, pdMS_TO_TICKS(10)) != pdTRUE)
+    return 0;
+
+  uint32_t token = 0;
+  for (auto& d : deferred) {
+    if (d.token)
+      continue;
+
+    // 0 means a free slot, so never hand it out
+    token = nextDeferredToken++;
+    if (!nextDeferredToken)
+      nextDeferredToken = 1;
+
+    d.token = token;
+    d.context = context;
+    d.msgid = output["msgid"] | 0;
+    d.started = millis();
+    d.waiter = context.mode == YBP_MODE_HTTP ? xTaskGetCurrentTaskHandle() : nullptr;
+    d.done = false;
+    d.result.clear();
+    break;
+  }
+
+  xSemaphoreGive(deferredMutex);
+
+  if (token) {
+    output["status"] = "pending";
+    output["token"] = token;
+  }
+
+  return token;
+}
+
+bool ProtocolController::completeDeferred(uint32_t token, JsonVariantConst result)
+{
+  if (!token || deferredMutex == NULL)
+    return false;
+
+  if (xSemaphoreTake(deferredMutex, portMAX_DELAY) != pdTRUE)
+    return false;
+
+  bool found = false;
+  TaskHandle_t waiter = nullptr;
+  DeferredReply* d = findDeferred(token);
+  if (d != nullptr && !d->done) {
+    d->result.set(result);
+
+    // same as runCommand, so the client can match it up
+    if (d->msgid) {
+      if (!d->result["status"].is<const char*>())
+        d->result["status"] = "ok";
+      d->result["msgid"] = d->msgid;
+    }
+
+    d->done = true;
+    waiter = d->waiter;
+    found = true;
+  }
+
+  xSemaphoreGive(deferredMutex);
+
+  if (waiter != nullptr)
+    xTaskNotifyGive(waiter);
+  else if (found)
+    _app.wakeLoop();
+
+  return found;
+}
+
+bool ProtocolController::deferToWorker(JsonVariant output, ProtocolContext context, DeferredWork work)
+{
+  if (deferredJobs == NULL)
+    return false;
+
+  uint32_t token = deferReply(output, context);
+  if (!token)
+    return false;
+
+  DeferredJob job = {token, work};
+  if (xQueueSend(deferredJobs, &job, 0) != pdTRUE) {
+    cancelDeferred(token, output);
+    return false;
+  }
+
+  return true;
+}
+
+void ProtocolController::deferredWorkerTask(void* arg)
+{
+  ProtocolController* self = static_cast<ProtocolController*>(arg);
+  DeferredJob job;
+
+  while (true) {
+    if (xQueueReceive(self->deferredJobs, &job, portMAX_DELAY) != pdTRUE)
+      continue;
+
+    JsonDocument result;
+    job.work(result.to<JsonVariant>());
+    self->completeDeferred(job.token, result);
+  }
+}
+
+ProtocolController::DeferredReply* ProtocolController::findDeferred(uint32_t token)
+{
+  for (auto& d : deferred) {
+    if (d.token == token)
+      return &d;
+  }
+
+  return nullptr;
+}
+
+// put the output back the way runCommand had it
+void ProtocolController::cancelDeferred(uint32_t token, JsonVariant output)
+{
+  xSemaphoreTake(deferredMutex, portMAX_DELAY);
+  DeferredReply* d = findDeferred(token);
+  if (d != nullptr)
+    d->token = 0;
+  xSemaphoreGive(deferredMutex);
+
+  output.remove("token");
+  if (output["msgid"].is<unsigned int>())
+    output["status"] = "ok";
+  else
+    output.remove("status");
+}
+
+// the server task can't serve anyone else while it waits here, so only wait a little.
+// after that they get the pending status and token, and pick the reply up with get_deferred.
+void ProtocolController::waitDeferred(uint32_t token, JsonVariant output)
+{
+  uint32_t start = millis();
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  bool waiting = true;
+
+  // get_deferred has its own msgid
+  uint32_t msgid = output["msgid"] | 0;
+
+  while (true) {
+    bool done = false;
+    uint32_t elapsed = millis() - start;
+    if (elapsed >= YB_PROTOCOL_HTTP_WAIT_MS)
+      waiting = false;
+
+    xSemaphoreTake(deferredMutex, portMAX_DELAY);
+    DeferredReply* d = findDeferred(token);
+    if (d != nullptr && d->done) {
+      output.set(d->result);
+      d->token = 0;
+      d->result.clear();
+      deferredCompleted++;
+      done = true;
+    }
+    // completeDeferred() wakes whoever is in here
+    else if (d != nullptr)
+      d->waiter = waiting ? self : nullptr;
+    xSemaphoreGive(deferredMutex);
+
+    if (done) {
+      if (msgid) {
+        if (!output["status"].is<const char*>())
+          output["status"] = "ok";
+        output["msgid"] = msgid;
+      }
+      return;
+    }
+
+    // timed out while nobody was waiting on it
+    if (d == nullptr) {
+      output.remove("token");
+      return generateErrorJSON(output, "Timed out.");
+    }
+
+    // leave it pending, deliverDeferred() times it out if nobody comes back for it
+    if (!waiting)
+      return;
+
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(YB_PROTOCOL_HTTP_WAIT_MS - elapsed));
+  }
+}
+
+void ProtocolController::handleGetDeferred(JsonVariantConst input, JsonVariant output, ProtocolContext context)
+{
+  uint32_t token = input["token"] | 0;
+
+  xSemaphoreTake(deferredMutex, portMAX_DELAY);
+  DeferredReply* d = findDeferred(token);
+
+  // only http leaves replies around to be picked up, and only for the same role or better
+  bool ok = context.mode == YBP_MODE_HTTP && d != nullptr && d->context.mode == YBP_MODE_HTTP &&
+            d->waiter == nullptr && _app.auth.hasPermission(d->context.role, context.role);
+
+  // runCommand waits on it again for us
+  if (ok) {
+    output["status"] = "pending";
+    output["token"] = token;
+  }
+  xSemaphoreGive(deferredMutex);
+
+  if (!ok)
+    return generateErrorJSON(output, "Unknown token.");
+}
+
+void ProtocolController::deliverDeferred()
+{
+  if (deferredMutex == NULL)
+    return;
+
+  for (auto& d : deferred) {
+    // http waits for its own reply
+    if (!d.token || d.waiter != nullptr)
+      continue;
+
+    JsonDocument result;
+    ProtocolContext context;
+    bool ready = false;
+
+    xSemaphoreTake(deferredMutex, portMAX_DELAY);
+
+    // http replies are picked up with get_deferred, we just clean up after them
+    if (d.token && d.context.mode == YBP_MODE_HTTP) {
+      if (d.waiter == nullptr && millis() - d.started >= YB_PROTOCOL_DEFERRED_TIMEOUT_MS) {
+        d.token = 0;
+        d.result.clear();
+        deferredTimeouts++;
+      }
+    } else if (d.token) {
+      if (d.done) {
+        result = std::move(d.result);
+        deferredCompleted++;
+        ready = true;
+      } else if (millis() - d.started >= YB_PROTOCOL_DEFERRED_TIMEOUT_MS) {
+        generateErrorJSON(result, "Timed out.");
+        if (d.msgid)
+          result["msgid"] = d.msgid;
+        deferredTimeouts++;
+        ready = true;
+      }
+
+      if (ready) {
+        context = d.context;
+        d.token = 0;
+        d.result.clear();
+      }
+    }
+    xSemaphoreGive(deferredMutex);
+
+    // send it outside the lock, the worker might be waiting on it
+    if (ready)
+      sendDeferred(result, context);
+  }
+}
+
+void ProtocolController::sendDeferred(JsonVariantConst result, ProtocolContext context)
+{
+  // we can have empty responses
+  if (!result.size())
+    return;
+
+  if (context.mode == YBP_MODE_WEBSOCKET)
+    _app.http.sendToWebsocket(context.clientId, result, NOBODY);
+  else if (context.mode == YBP_MODE_SERIAL)
+    serialFramer.writeFrame(result, context.encoding == YB_ENCODING_MSGPACK);
+  else if (context.mode == YBP_MODE_MQTT)
+    _app.mqtt.publishResponse(result);
+  else
+    return;
+
+  sentMessages++;
+  totalSentMessages++;
+}
+
+void ProtocolController::checkPendingWifi()
+{
+  // try connecting.
+  if (pendingWifi.requested.exchange(false)) {
+    YBP.printf("Trying new wifi %s / %s\n", pendingWifi.ssid, pendingWifi.pass);
+    _app.network.beginConnect(pendingWifi.ssid, pendingWifi.pass);
+    pendingWifi.connecting = true;
+  }
+
+  if (!pendingWifi.connecting)
+    return;
+
+  int result = _app.network.checkConnect();
+  if (result == 0)
+    return;
+
+  JsonDocument reply;
+
+  // back on our old wifi, now give them the bad news
+  if (pendingWifi.reverting) {
+    _app.network.startServices();
+    generateErrorJSON(reply, "Can't connect to new WiFi.");
+  } else if (result > 0) {
+    // changing modes?
+    if (!strcmp(_cfg.wifi_mode, "ap"))
+      WiFi.softAPdisconnect();
+
+    // save for local use
+    strlcpy(_cfg.wifi_mode, pendingWifi.mode, sizeof(_cfg.wifi_mode));
+    strlcpy(_cfg.wifi_ssid, pendingWifi.ssid, sizeof(_cfg.wifi_ssid));
+    strlcpy(_cfg.wifi_pass, pendingWifi.pass, sizeof(_cfg.wifi_pass));
+
+    // save it to file.
+    char error[128];
+    if (!_cfg.saveConfig(error, sizeof(error)))
+      generateErrorJSON(reply, error);
+  }
+  // nope, go back to our old wifi.  we'll hear how that went on a later pass.
+  else {
+    pendingWifi.reverting = true;
+    _app.network.beginConnect(_cfg.wifi_ssid, _cfg.wifi_pass);
+    return;
+  }
+
+  completeDeferred(pendingWifi.token, reply);
+  pendingWifi.token = 0;
+  pendingWifi.connecting = false;
+  pendingWifi.busy = false;
+}
+
 void ProtocolController::handleHello(JsonVariantConst input, JsonVariant output, ProtocolContext context)
 {
   output["msg"] = "hello";
+
+  // does this websocket want binary frames from now on?
+  if (context.mode == YBP_MODE_WEBSOCKET) {
+    if (input["encoding"].is<const char*>()) {
+      YBEncoding encoding = strcmp(input["encoding"], "msgpack") ? YB_ENCODING_JSON : YB_ENCODING_MSGPACK;
+      _app.http.setClientEncoding(context.clientId, encoding);
+    }
+    output["encoding"] = _app.http.getClientEncoding(context.clientId) == YB_ENCODING_MSGPACK ? "msgpack" : "json";
+  }
+
+  // wired integrations can switch to cobs frames, and msgpack inside them
+  if (context.mode == YBP_MODE_SERIAL) {
+    if (input["framing"].is<const char*>())
+      serialFramingNext = strcmp(input["framing"], "cobs") ? YB_SERIAL_FRAMING_LINE : YB_SERIAL_FRAMING_COBS;
+    if (input["encoding"].is<const char*>())
+      serialEncoding = strcmp(input["encoding"], "msgpack") ? YB_ENCODING_JSON : YB_ENCODING_MSGPACK;
+
+    // msgpack only fits in cobs frames
+    if (serialFramingNext == YB_SERIAL_FRAMING_LINE)
+      serialEncoding = YB_ENCODING_JSON;
+
+    output["framing"] = serialFramingNext == YB_SERIAL_FRAMING_COBS ? "cobs" : "line";
+    output["encoding"] = serialEncoding == YB_ENCODING_MSGPACK ? "msgpack" : "json";
+  }
+
   output["role"] = _app.auth.getRoleText(context.role);
   output["default_role"] = _app.auth.getRoleText(_cfg.app_default_role);
   output["name"] = _cfg.board_name;
@@ -218,13 +1131,19 @@ void ProtocolController::handleGetStats(JsonVariantConst input, JsonVariant outp
   // some basic statistics and info
   output["msg"] = "stats";
   output["uuid"] = _cfg.uuid;
-  output["received_message_total"] = totalReceivedMessages;
+  output["received_message_total"] = totalReceivedMessages.load();
   output["received_message_mps"] = receivedMessagesPerSecond;
-  output["sent_message_total"] = totalSentMessages;
+  output["sent_message_total"] = totalSentMessages.load();
   output["sent_message_mps"] = sentMessagesPerSecond;
   output["websocket_client_count"] = _app.http.websocketClientCount;
+  output["websocket_dropped"] = _app.http.websocketDropped;
+  output["bytes_sent_json"] = _app.http.bytesSentJson + serialFramer.bytesJson;
+  output["bytes_sent_msgpack"] = _app.http.bytesSentMsgPack + serialFramer.bytesMsgPack;
   output["http_client_count"] = _app.http.httpClientCount - _app.http.websocketClientCount;
   output["fps"] = (int)_app.framerate;
+  output["loop_wakeups"] = _app.loopWakeups;
+  output["loop_wakeups_total"] = _app.totalLoopWakeups;
+  output["loop_utilization"] = round2(_app.loopUtilization);
   output["uptime"] = esp_timer_get_time();
   output["heap_size"] = ESP.getHeapSize();
   output["free_heap"] = ESP.getFreeHeap();
@@ -238,19 +1157,293 @@ void ProtocolController::handleGetStats(JsonVariantConst input, JsonVariant outp
   else
     output["ip_address"] = WiFi.localIP();
 
+  // who is hogging the main loop?
+  JsonObject budget = output["loop_budget"].to<JsonObject>();
+  budget["frame_budget_us"] = _app.frame_budget_us;
+  budget["frame_overruns"] = _app.frameOverruns;
+  JsonArray budgets = budget["controllers"].to<JsonArray>();
   for (const auto& entry : _app.getControllers()) {
-    entry.controller->generateStatsHook(output);
+    BaseController* c = entry.controller;
+    JsonObject b = budgets.add<JsonObject>();
+    b["name"] = c->getName();
+    b["budget_us"] = c->getLoopBudget();
+    b["last_us"] = c->getLastLoopMicros();
+    b["worst_us"] = c->getWorstLoopMicros();
+    b["worst_at"] = c->getWorstLoopMillis();
+    b["overruns"] = c->getBudgetOverruns();
+    b["deferred"] = c->getDeferredLoops();
+  }
+
+  // who is getting turned away?
+  JsonObject limits = output["rate_limit"].to<JsonObject>();
+  limits["client_rate"] = rate_limit_client_rate;
+  limits["client_burst"] = rate_limit_client_burst;
+  limits["transport_rate"] = rate_limit_transport_rate;
+  limits["transport_burst"] = rate_limit_transport_burst;
+  if (rateMutex != NULL && xSemaphoreTake(rateMutex, pdMS_TO_TICKS(10)) == pdTRUE) {
+    JsonObject transports = limits["transports"].to<JsonObject>();
+    for (uint8_t mode = YBP_MODE_WEBSOCKET; mode <= YBP_MODE_MQTT; mode++)
+      transports[getModeName((YBMode)mode)] = rateTransports[mode].dropped;
+
+    JsonArray clients = limits["clients"].to<JsonArray>();
+    for (const auto& c : rateClients) {
+      JsonObject jc = clients.add<JsonObject>();
+      jc["transport"] = getModeName(c.mode);
+      if (c.mode == YBP_MODE_HTTP)
+        jc["id"] = IPAddress(c.id).toString();
+      else
+        jc["id"] = c.id;
+      jc["tokens"] = c.bucket.tokens();
+      jc["dropped"] = c.dropped;
+    }
+
+    xSemaphoreGive(rateMutex);
+  }
+
+  // and which commands?  only the ones that have run, to keep this small
+  generateCommandStats(output["commands"].to<JsonArray>(), false);
+
+  output["serial_frames"] = serialFramer.frames;
+  output["serial_overflows"] = serialFramer.overflows;
+  output["serial_errors"] = serialFramer.errors;
+  output["events_published"] = _app.events.published;
+  output["events_dropped"] = _app.events.dropped;
+  output["fast_update_window_ms"] = fast_update_window_ms;
+  output["fast_update_max_rate"] = fast_update_max_rate;
+  output["fast_updates_sent"] = fastUpdatesSent;
+  output["fast_updates_merged"] = FastUpdateFlag::merged.load();
+  output["fast_updates_throttled"] = fastUpdatesThrottled;
+  output["update_version"] = updates.version();
+  output["update_fields"] = updates.fieldCount();
+  output["update_field_overflows"] = updates.overflows;
+  output["update_snapshots_built"] = updatesBuilt;
+  output["update_snapshots_shared"] = updatesShared;
+  output["filtered_messages"] = filteredMessages.load();
+
+  uint8_t deferredPending = 0;
+  for (const auto& d : deferred)
+    if (d.token)
+      deferredPending++;
+  output["deferred_pending"] = deferredPending;
+  output["deferred_completed"] = deferredCompleted;
+  output["deferred_timeouts"] = deferredTimeouts;
+
+  // how long did it take to get going?
+  JsonObject boot = output["boot"].to<JsonObject>();
+  boot["complete"] = _app.isBootComplete();
+  boot["complete_us"] = _app.getBootCompleteMicros();
+  JsonArray timeline = boot["timeline"].to<JsonArray>();
+  for (const auto& e : _app.getBootTimeline()) {
+    JsonObject event = timeline.add<JsonObject>();
+    event["name"] = e.name;
+    event["start_us"] = e.start_us;
+    event["duration_us"] = e.duration_us;
+    event["ok"] = e.ok;
+  }
+
+  // how many controllers listen to each hook?
+  JsonObject hooks = output["hook_subscribers"].to<JsonObject>();
+  for (uint8_t hook = 0; hook < YB_HOOK_COUNT; hook++)
+    hooks[YarrboardApp::getHookName((YBHook)hook)] = _app.getHookSubscribers((YBHook)hook).size();
+
+  for (BaseController* c : _app.getHookSubscribers(YB_HOOK_STATS)) {
+    c->generateStatsHook(output);
   }
 }
 
+void ProtocolController::handleGetCommandStats(JsonVariantConst input, JsonVariant output, ProtocolContext context)
+{
+  bool reset = input["reset"] | false;
+  if (reset && !_app.auth.hasPermission(ADMIN, context.role))
+    return generateErrorJSON(output, "Unauthorized for reset");
+
+  output["msg"] = "command_stats";
+  output["uptime"] = esp_timer_get_time();
+  generateCommandStats(output["commands"].to<JsonArray>(), true);
+
+  // start a fresh measurement window
+  if (reset) {
+    bool locked = lockCommands();
+    for (auto& entry : commands) {
+      entry.calls = 0;
+      entry.errors = 0;
+      entry.latency.clear();
+    }
+    unlockCommands(locked);
+  }
+}
+
+void ProtocolController::generateCommandStats(JsonArray output, bool full)
+{
+  bool locked = lockCommands();
+  for (const auto& entry : commands) {
+    if (!full && entry.calls == 0)
+      continue;
+
+    JsonObject c = output.add<JsonObject>();
+    c["name"] = entry.command;
+    c["calls"] = entry.calls;
+    c["errors"] = entry.errors;
+    entry.latency.generateStats(c, full);
+  }
+  unlockCommands(locked);
+}
+
 void ProtocolController::handleGetUpdate(JsonVariantConst input, JsonVariant output, ProtocolContext context)
 {
+  UpdateSnapshot* snapshot = acquireUpdate();
+  if (snapshot == nullptr)
+    return generateErrorJSON(output, "Unable to generate update.");
+
+  JsonObjectConst state = snapshot->state();
+
+  // subscribed clients only get what they asked for
+  JsonDocument filtered;
+  if (context.mode == YBP_MODE_WEBSOCKET) {
+    Subscriber* s = findSubscriber(context.clientId);
+    if (s != nullptr) {
+      filterForSubscriber(state, filtered.to<JsonObject>(), *s, YB_HOOK_UPDATE);
+      state = filtered.as<JsonObjectConst>();
+    }
+  }
+
   output["msg"] = "update";
-  output["uptime"] = esp_timer_get_time();
+  output["version"] = snapshot->version;
+
+  // clients that tell us what they already have only get the changes
+  uint32_t since = input["since"] | 0;
+  if (updates.canDelta(since) && xSemaphoreTake(updateMutex, portMAX_DELAY) == pdTRUE) {
+    output["delta"] = true;
+    updates.generateDelta(state, since, output);
+    xSemaphoreGive(updateMutex);
+  } else {
+    for (JsonPairConst kv : state)
+      output[kv.key()] = kv.value();
+  }
 
-  for (const auto& entry : _app.getControllers()) {
-    entry.controller->generateUpdateHook(output);
+  snapshot->release();
+}
+
+UpdateSnapshot* ProtocolController::acquireUpdate()
+{
+  if (updateMutex == NULL || xSemaphoreTake(updateMutex, portMAX_DELAY) != pdTRUE)
+    return nullptr;
+
+  // built one just now?  timed by the clock, not the frame count, this runs off the loop too.
+  int64_t now = esp_timer_get_time();
+  if (currentUpdate != nullptr && now - currentUpdate->built_us < YB_UPDATE_SNAPSHOT_MAX_AGE_MS * 1000LL) {
+    currentUpdate->retain();
+    updatesShared++;
+
+    UpdateSnapshot* snapshot = currentUpdate;
+    xSemaphoreGive(updateMutex);
+    return snapshot;
   }
+
+  UpdateSnapshot* snapshot = UpdateSnapshot::create();
+  if (snapshot == nullptr) {
+    xSemaphoreGive(updateMutex);
+    return nullptr;
+  }
+
+  snapshot->doc["uptime"] = now;
+  for (BaseController* c : _app.getHookSubscribers(YB_HOOK_UPDATE))
+    c->generateUpdateHook(snapshot->doc);
+
+  // stamp whatever changed since last time
+  snapshot->version = updates.update(snapshot->doc);
+  snapshot->built_us = now;
+  updatesBuilt++;
+
+  // one reference for us, one for the caller.  readers of the old one keep it alive.
+  if (currentUpdate != nullptr)
+    currentUpdate->release();
+  currentUpdate = snapshot;
+  snapshot->retain();
+
+  xSemaphoreGive(updateMutex);
+  return snapshot;
+}
+
+void ProtocolController::handleSubscribe(JsonVariantConst input, JsonVariant output, ProtocolContext context)
+{
+  if (context.mode != YBP_MODE_WEBSOCKET)
+    return generateErrorJSON(output, "Subscriptions are only available over websockets.");
+
+  if (!input["controller"].is<const char*>())
+    return generateErrorJSON(output, "'controller' is a required parameter.");
+
+  const char* name = input["controller"];
+  if (_app.getController(name) == nullptr) {
+    String error = "Invalid controller: " + String(name);
+    return generateErrorJSON(output, error.c_str());
+  }
+
+  Topic topic = {hashCommand(name, 0), 0};
+  if (input["channel"].is<const char*>())
+    topic.channel = hashCommand(input["channel"], 0);
+
+  Subscriber* s = findSubscriber(context.clientId);
+  if (s == nullptr) {
+    if (subscribers.full())
+      return generateErrorJSON(output, "Too many subscribers.");
+
+    subscribers.push_back({context.clientId, {}});
+    s = &subscribers.back();
+
+    // from now on they only get what they asked for
+    _app.http.setClientFiltered(context.clientId, true);
+  }
+
+  // already got it?
+  for (auto& t : s->topics) {
+    if (t.controller == topic.controller && t.channel == topic.channel)
+      return generateSuccessJSON(output, "Subscribed.");
+  }
+
+  if (s->topics.full()) {
+    char error[64];
+    snprintf(error, sizeof(error), "Maximum of %d subscriptions.", YB_PROTOCOL_MAX_SUBSCRIPTIONS);
+    return generateErrorJSON(output, error);
+  }
+
+  s->topics.push_back(topic);
+
+  return generateSuccessJSON(output, "Subscribed.");
+}
+
+void ProtocolController::handleUnsubscribe(JsonVariantConst input, JsonVariant output, ProtocolContext context)
+{
+  if (context.mode != YBP_MODE_WEBSOCKET)
+    return generateErrorJSON(output, "Subscriptions are only available over websockets.");
+
+  Subscriber* s = findSubscriber(context.clientId);
+  if (s == nullptr)
+    return generateSuccessJSON(output, "Unsubscribed.");
+
+  // no controller means everything
+  if (!input["controller"].is<const char*>()) {
+    removeSubscriber(context.clientId);
+    return generateSuccessJSON(output, "Unsubscribed.");
+  }
+
+  uint32_t controller = hashCommand(input["controller"], 0);
+  uint32_t channel = 0;
+  if (input["channel"].is<const char*>())
+    channel = hashCommand(input["channel"], 0);
+
+  for (auto it = s->topics.begin(); it != s->topics.end();) {
+    if (it->controller == controller && (channel == 0 || it->channel == channel))
+      it = s->topics.erase(it);
+    else
+      ++it;
+  }
+
+  // nothing left, back to getting everything
+  if (s->topics.empty())
+    removeSubscriber(context.clientId);
+
+  return generateSuccessJSON(output, "Unsubscribed.");
 }
 
 void ProtocolController::handleGetFullConfig(JsonVariantConst input, JsonVariant output, ProtocolContext context)
@@ -347,28 +1540,24 @@ void ProtocolController::handleSetNetworkConfig(JsonVariantConst input, JsonVari
   if (!strcmp(new_wifi_mode, "client")) {
     // did we change username/password?
     if (strcmp(new_wifi_ssid, _cfg.wifi_ssid) || strcmp(new_wifi_pass, _cfg.wifi_pass)) {
-      // try connecting.
-      YBP.printf("Trying new wifi %s / %s\n", new_wifi_ssid, new_wifi_pass);
-      if (_app.network.connectToWifi(new_wifi_ssid, new_wifi_pass)) {
-        // changing modes?
-        if (!strcmp(_cfg.wifi_mode, "ap"))
-          WiFi.softAPdisconnect();
-
-        // save for local use
-        strlcpy(_cfg.wifi_mode, new_wifi_mode, sizeof(_cfg.wifi_mode));
-        strlcpy(_cfg.wifi_ssid, new_wifi_ssid, sizeof(_cfg.wifi_ssid));
-        strlcpy(_cfg.wifi_pass, new_wifi_pass, sizeof(_cfg.wifi_pass));
-
-        // save it to file.
-        if (!_cfg.saveConfig(error, sizeof(error)))
-          return generateErrorJSON(output, error);
-      }
-      // nope, setup our wifi back to default.
-      else {
-        _app.network.connectToWifi(_cfg.wifi_ssid, _cfg.wifi_pass); // go back to our old wifi.
-        _app.network.startServices();
-        return generateErrorJSON(output, "Can't connect to new WiFi.");
+      // one at a time
+      if (pendingWifi.busy.exchange(true))
+        return generateErrorJSON(output, "Already trying a new WiFi.");
+
+      // connecting takes a few seconds, the real answer comes from checkPendingWifi()
+      uint32_t token = deferReply(output, context);
+      if (!token) {
+        pendingWifi.busy = false;
+        return generateErrorJSON(output, "Too many pending commands, try again.");
       }
+
+      // this can be the http task, so hand it to the loop and let it do the connecting
+      pendingWifi.token = token;
+      pendingWifi.reverting = false;
+      strlcpy(pendingWifi.mode, new_wifi_mode, sizeof(pendingWifi.mode));
+      strlcpy(pendingWifi.ssid, new_wifi_ssid, sizeof(pendingWifi.ssid));
+      strlcpy(pendingWifi.pass, new_wifi_pass, sizeof(pendingWifi.pass));
+      pendingWifi.requested = true;
     } else {
       // save it to file.
       if (!_cfg.saveConfig(error, sizeof(error)))
@@ -637,10 +1826,12 @@ void ProtocolController::handleSetBrightness(JsonVariantConst input, JsonVariant
     // TODO: need to put this on a time delay
     // preferences.putFloat("brightness", globalBrightness);
 
-    for (const auto& entry : _app.getControllers()) {
-      entry.controller->updateBrightnessHook(brightness);
+    for (BaseController* c : _app.getHookSubscribers(YB_HOOK_BRIGHTNESS)) {
+      c->updateBrightnessHook(brightness);
     }
     sendBrightnessUpdate();
+
+    _app.events.publish(YBEvent(YB_EVENT_BRIGHTNESS_CHANGED, _name, 0, brightness));
   } else
     return generateErrorJSON(output, "'brightness' is a required parameter.");
 }
@@ -719,11 +1910,141 @@ void ProtocolController::sendFastUpdate()
   output["fast"] = 1;
   output["uptime"] = esp_timer_get_time();
 
-  for (const auto& entry : _app.getControllers()) {
-    entry.controller->generateFastUpdateHook(output);
+  // only run the hooks someone is listening to
+  for (BaseController* c : _app.getHookSubscribers(YB_HOOK_FAST_UPDATE)) {
+    if (wantsController(c))
+      c->generateFastUpdateHook(output);
+  }
+
+  if (subscribers.empty())
+    return sendToAll(output, GUEST);
+
+  // everyone without subscriptions gets the whole thing
+  _app.http.sendToAllWebsockets(output, GUEST, true);
+  sendToSerial(output, GUEST);
+
+  // and everyone else just the parts they asked for
+  for (auto& s : subscribers) {
+    JsonDocument filtered;
+    if (filterForSubscriber(output, filtered.to<JsonObject>(), s, YB_HOOK_FAST_UPDATE))
+      _app.http.sendToWebsocket(s.socket, filtered, GUEST);
+  }
+}
+
+ProtocolController::Subscriber* ProtocolController::findSubscriber(int socket)
+{
+  for (auto& s : subscribers) {
+    if (s.socket == socket)
+      return &s;
+  }
+
+  return nullptr;
+}
+
+void ProtocolController::removeSubscriber(int socket)
+{
+  for (auto it = subscribers.begin(); it != subscribers.end(); ++it) {
+    if (it->socket == socket) {
+      subscribers.erase(it);
+      _app.http.setClientFiltered(socket, false);
+      break;
+    }
+  }
+}
+
+void ProtocolController::onClientDisconnected(const YBEvent& event)
+{
+  removeSubscriber(event.id);
+  removeRateClient(YBP_MODE_WEBSOCKET, event.id);
+}
+
+// does anybody want this controller's updates?
+bool ProtocolController::wantsController(BaseController* c)
+{
+  // serial and unsubscribed clients want everything
+  if (_cfg.app_enable_serial || subscribers.size() < _app.http.websocketClientCount)
+    return true;
+
+  uint32_t controller = hashCommand(c->getName(), 0);
+  for (auto& s : subscribers) {
+    if (wantsAnyOf(s, controller))
+      return true;
+  }
+
+  return false;
+}
+
+// channel 0 only matches a subscription to the whole controller
+bool ProtocolController::wantsTopic(const Subscriber& s, uint32_t controller, uint32_t channel)
+{
+  for (auto& t : s.topics) {
+    if (t.controller == controller && (t.channel == 0 || t.channel == channel))
+      return true;
+  }
+
+  return false;
+}
+
+bool ProtocolController::wantsAnyOf(const Subscriber& s, uint32_t controller)
+{
+  for (auto& t : s.topics) {
+    if (t.controller == controller)
+      return true;
   }
 
-  sendToAll(output, GUEST);
+  return false;
+}
+
+// copy over everything except controller data they didn't ask for.
+// returns false if none of the controller data was for them.
+bool ProtocolController::filterForSubscriber(JsonVariantConst input, JsonVariant output, const Subscriber& s,
+  YBHook hook)
+{
+  bool found = false;
+
+  for (JsonPairConst kv : input.as<JsonObjectConst>()) {
+    const char* key = kv.key().c_str();
+
+    // is this one of our controllers?
+    bool isController = false;
+    for (BaseController* c : _app.getHookSubscribers(hook)) {
+      if (!strcmp(c->getName(), key)) {
+        isController = true;
+        break;
+      }
+    }
+
+    if (!isController) {
+      output[key] = kv.value();
+      continue;
+    }
+
+    uint32_t controller = hashCommand(key, 0);
+
+    // the whole thing
+    if (wantsTopic(s, controller, 0)) {
+      output[key] = kv.value();
+      found = true;
+      continue;
+    }
+
+    // or just some of the channels
+    if (kv.value().is<JsonArrayConst>()) {
+      JsonArray channels = output[key].to<JsonArray>();
+      for (JsonVariantConst ch : kv.value().as<JsonArrayConst>()) {
+        const char* chKey = ch["key"];
+        if (chKey != nullptr && wantsTopic(s, controller, hashCommand(chKey, 0)))
+          channels.add(ch);
+      }
+
+      if (channels.size())
+        found = true;
+      else
+        output.remove(key);
+    }
+  }
+
+  return found;
 }
 
 void ProtocolController::sendDebug(const char* message)
@@ -736,26 +2057,29 @@ void ProtocolController::sendDebug(const char* message)
 
 void ProtocolController::sendToAll(JsonVariantConst output, UserRole auth_level)
 {
-  // dynamically allocate our buffer
-  size_t jsonSize = measureJson(output);
-  char* jsonBuffer = (char*)malloc(jsonSize + 1);
+  // controller tasks hand their messages off to the main loop.
+  if (_app.queueMessageForMainLoop(output, auth_level))
+    return;
 
-  // did we get anything?
-  if (jsonBuffer != NULL) {
-    jsonBuffer[jsonSize] = '\0'; // null terminate
-    serializeJson(output, jsonBuffer, jsonSize + 1);
-    sendToAll(jsonBuffer, auth_level);
-    free(jsonBuffer);
-  } else {
-    // dont call YBP b/c loops...
-    Serial.println("Error allocating in ProtocolController::sendToAll");
-  }
+  // stream it straight out, no full size buffer needed
+  _app.http.sendToAllWebsockets(output, auth_level);
+  sendToSerial(output, auth_level);
+}
+
+void ProtocolController::sendToSerial(JsonVariantConst output, UserRole auth_level)
+{
+  if (_cfg.app_enable_serial && _cfg.serial_role >= auth_level)
+    serialFramer.writeFrame(output, serialEncoding == YB_ENCODING_MSGPACK);
 }
 
 void ProtocolController::sendToAll(const char* jsonString, UserRole auth_level)
 {
+  // controller tasks hand their messages off to the main loop.
+  if (_app.queueMessageForMainLoop(jsonString, auth_level))
+    return;
+
   _app.http.sendToAllWebsockets(jsonString, auth_level);
 
   if (_cfg.app_enable_serial && _cfg.serial_role >= auth_level)
-    Serial.println(jsonString);
+    serialFramer.writeFrame(jsonString, strlen(jsonString));
 }
@@ -14,15 +14,27 @@
 #define YARR_PROTOCOL_H
 
 #include "YarrboardConfig.h"
+
+#include "CommandTable.h"
+#include "DeltaTracker.h"
+#include "EventBus.h"
+#include "LatencyHistogram.h"
+#include "SerialFramer.h"
+#include "TokenBucket.h"
+#include "UpdateSnapshot.h"
 #include "controllers/AuthController.h"
 #include "controllers/BaseController.h"
 #include "utility.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <PsychicHttp.h>
+#include <atomic>
 #include <cstring>
-#include <etl/map.h>
-#include <functional>
+#include <etl/array.h>
+#include <etl/delegate.h>
+#include <etl/vector.h>
+#include <new>
+#include <type_traits>
 
 typedef enum {
   YBP_MODE_NONE,
@@ -32,6 +44,26 @@ typedef enum {
   YBP_MODE_MQTT
 } YBMode;
 
+// wire format, negotiated per websocket client in hello
+typedef enum {
+  YB_ENCODING_JSON,
+  YB_ENCODING_MSGPACK
+} YBEncoding;
+
+// what to do with an inbound message, before it is parsed
+typedef enum {
+  YB_ADMIT_OK,
+  YB_ADMIT_REJECT, // over the limit, send rateLimitedJSON back
+  YB_ADMIT_DROP    // still over the limit, and they've already been told
+} YBAdmit;
+
+// inbound websocket messages are queued by lane, control is always drained first
+typedef enum {
+  YB_LANE_CONTROL, // anything that changes state
+  YB_LANE_POLL,    // get_*, ping
+  YB_LANE_COUNT
+} YBLane;
+
 class YarrboardApp;
 class ConfigManager;
 
@@ -39,11 +71,44 @@ struct ProtocolContext {
     YBMode mode = YBP_MODE_NONE;
     UserRole role = NOBODY;
     uint32_t clientId = 0;
+    YBEncoding encoding = YB_ENCODING_JSON; // of the incoming message
 };
 
 // message handler callback definition
-// void(JsonVariantConst input, JsonVariant output)
-using ProtocolMessageHandler = std::function<void(JsonVariantConst, JsonVariant, ProtocolContext)>;
+// void(JsonVariantConst input, JsonVariant output, ProtocolContext context)
+//
+// Fixed size, never allocates.  Holds any trivially copyable callable that fits in
+// YB_PROTOCOL_HANDLER_SIZE bytes: free functions, lambdas with small captures, etc.
+class ProtocolMessageHandler
+{
+  public:
+    ProtocolMessageHandler() = default;
+
+    template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, ProtocolMessageHandler>::value>::type>
+    ProtocolMessageHandler(F callable)
+    {
+      static_assert(sizeof(F) <= YB_PROTOCOL_HANDLER_SIZE, "Command handler captures too much, raise YB_PROTOCOL_HANDLER_SIZE");
+      static_assert(std::is_trivially_copyable<F>::value, "Command handler captures must be trivially copyable");
+
+      new (_storage) F(callable);
+      _invoke = [](const void* storage, JsonVariantConst input, JsonVariant output, ProtocolContext context) {
+        (*static_cast<const F*>(storage))(input, output, context);
+      };
+    }
+
+    void operator()(JsonVariantConst input, JsonVariant output, ProtocolContext context) const
+    {
+      _invoke(_storage, input, output, context);
+    }
+
+    explicit operator bool() const { return _invoke != nullptr; }
+
+  private:
+    typedef void (*Invoker)(const void*, JsonVariantConst, JsonVariant, ProtocolContext);
+
+    alignas(void*) unsigned char _storage[YB_PROTOCOL_HANDLER_SIZE] = {};
+    Invoker _invoke = nullptr;
+};
 
 class ProtocolController : public BaseController
 {
@@ -57,18 +122,22 @@ class ProtocolController : public BaseController
     bool hasCommand(const char* command);
     void printCommands();
 
+    // fields is an optional comma separated list of the top level keys the handler reads, eg "theme" or
+    // "controller,channel".  anything else is dropped while parsing.  "" takes no arguments, nullptr keeps everything.
+    // cmd, msgid, user and pass are always kept.  must be a string literal, we only keep the pointer.
+
     // Overload 1: Free Functions, Static Functions, Lambdas
     // Accepts any callable that matches the signature
-    bool registerCommand(UserRole role, const char* command, ProtocolMessageHandler handler);
+    bool registerCommand(UserRole role, const char* command, ProtocolMessageHandler handler, const char* fields = nullptr);
 
     // Overload 2: Member Function Helper
     template <typename T>
-    bool registerCommand(UserRole role, const char* command, T* instance, void (T::*method)(JsonVariantConst, JsonVariant, ProtocolContext))
+    bool registerCommand(UserRole role, const char* command, T* instance, void (T::*method)(JsonVariantConst, JsonVariant, ProtocolContext), const char* fields = nullptr)
     {
       // No casting needed on 'this'. We use the explicitly passed 'instance'.
       return registerCommand(role, command, [instance, method](JsonVariantConst in, JsonVariant out, ProtocolContext context) {
         (instance->*method)(in, out, context);
-      });
+      }, fields);
     }
 
     void sendBrightnessUpdate();
@@ -78,41 +147,242 @@ class ProtocolController : public BaseController
     void sendToAll(JsonVariantConst output, UserRole auth_level);
     void sendToAll(const char* jsonString, UserRole auth_level);
 
+    // input can be a single command object, or an array of them for a batch
     void handleReceivedJSON(JsonVariantConst input, JsonVariant output, ProtocolContext context);
     static void generateErrorJSON(JsonVariant output, const char* error);
     static void generateSuccessJSON(JsonVariant output, const char* success);
 
     void incrementSentMessages();
 
+    // -------------------------------------------------------------------------
+    // deferred replies, for handlers that can't answer without blocking
+    // -------------------------------------------------------------------------
+    typedef etl::delegate<void(JsonVariant result)> DeferredWork;
+
+    // call from inside a handler.  output becomes a "pending" status, and the real reply goes to the
+    // same client, with the same msgid, once completeDeferred() is called.  returns 0 if we're full.
+    uint32_t deferReply(JsonVariant output, ProtocolContext context);
+
+    // safe from any task.  result is the reply, msgid is added for you.
+    bool completeDeferred(uint32_t token, JsonVariantConst result);
+
+    // defer, and run work in the worker task.  whatever it writes to result is the reply.
+    bool deferToWorker(JsonVariant output, ProtocolContext context, DeferredWork work);
+
+    // the current update message, built at most once every YB_UPDATE_SNAPSHOT_MAX_AGE_MS
+    // no matter how many transports ask.  safe from any task, call release() when done.
+    UpdateSnapshot* acquireUpdate();
+
+    // token bucket check, done before the message is parsed.  safe from any task.
+    // clientId is whatever identifies the sender on that transport (socket, ip, etc)
+    YBAdmit admitMessage(YBMode mode, uint32_t clientId, const char* data, size_t len, bool binary = false);
+
+    // same thing, if you already ran scanCommand()
+    YBAdmit admitCommand(YBMode mode, uint32_t clientId, const char* cmd, uint8_t count);
+
+    // how many tokens a command costs, default 1.  0 makes it free.
+    bool setCommandWeight(const char* command, uint8_t weight);
+
+    // which inbound lane a command waits in.  get_* and ping default to poll, everything else to control.
+    bool setCommandLane(const char* command, YBLane lane);
+    YBLane getCommandLane(const char* command);
+    static const char* getLaneName(YBLane lane);
+
+    // what to send back when admitMessage() says no, serialized once up front
+    static const char* rateLimitedJSON;
+
+    // two phase parse: find "cmd" first, then parse only the fields that command reads.
+    // batches of more than one command are parsed whole.  safe from any task.
+    DeserializationError parseMessage(JsonDocument& input, const char* data, size_t len, bool binary = false);
+
+    // find "cmd" without parsing.  returns how many commands it saw (more than 1 for a batch)
+    static uint8_t scanCommand(const char* data, size_t len, bool binary, char* cmd, size_t cmdSize);
+
+    static const char* getModeName(YBMode mode);
+
+    // per client and per transport limits, 0 turns either one off
+    uint32_t rate_limit_client_rate = YB_RATE_LIMIT_CLIENT_RATE;
+    uint32_t rate_limit_client_burst = YB_RATE_LIMIT_CLIENT_BURST;
+    uint32_t rate_limit_transport_rate = YB_RATE_LIMIT_TRANSPORT_RATE;
+    uint32_t rate_limit_transport_burst = YB_RATE_LIMIT_TRANSPORT_BURST;
+
+    // coalescing for fast updates, 0 turns either one off
+    uint32_t fast_update_window_ms = YB_FAST_UPDATE_WINDOW_MS;
+    uint32_t fast_update_max_rate = YB_FAST_UPDATE_MAX_RATE;
+
   private:
     unsigned long previousMessageMillis = 0;
-    unsigned int receivedMessages = 0;
+    // bumped from the loop, the httpd task and the protocol workers
+    std::atomic<unsigned int> receivedMessages{0};
     unsigned int receivedMessagesPerSecond = 0;
-    unsigned long totalReceivedMessages = 0;
-    unsigned int sentMessages = 0;
+    std::atomic<unsigned long> totalReceivedMessages{0};
+    std::atomic<unsigned int> sentMessages{0};
     unsigned int sentMessagesPerSecond = 0;
-    unsigned long totalSentMessages = 0;
+    std::atomic<unsigned long> totalSentMessages{0};
+
+    bool fastUpdatePending = false;
+    bool fastUpdateThrottled = false;
+    uint32_t fastUpdatePendingSince = 0;
+    uint32_t lastFastUpdateMillis = 0;
+    uint32_t fastUpdatesSent = 0;
+    uint32_t fastUpdatesThrottled = 0;
+
+    // field versions for get_update deltas
+    DeltaTracker updates;
+
+    // shared update snapshot, and the lock for it and the tracker above
+    SemaphoreHandle_t updateMutex = NULL;
+    UpdateSnapshot* currentUpdate = nullptr;
+    uint32_t updatesBuilt = 0;
+    uint32_t updatesShared = 0;
+
+    // -------------------------------------------------------------------------
+    // update subscriptions.  websocket clients without any get everything.
+    // -------------------------------------------------------------------------
+    struct Topic {
+        uint32_t controller;
+        uint32_t channel; // 0 = every channel
+    };
+
+    struct Subscriber {
+        int socket;
+        etl::vector<Topic, YB_PROTOCOL_MAX_SUBSCRIPTIONS> topics;
+    };
+
+    etl::vector<Subscriber, YB_CLIENT_LIMIT> subscribers;
+
+    Subscriber* findSubscriber(int socket);
+    void removeSubscriber(int socket);
+    bool wantsController(BaseController* c);
+    static bool wantsTopic(const Subscriber& s, uint32_t controller, uint32_t channel);
+    static bool wantsAnyOf(const Subscriber& s, uint32_t controller);
+    bool filterForSubscriber(JsonVariantConst input, JsonVariant output, const Subscriber& s, YBHook hook);
+    void onClientDisconnected(const YBEvent& event);
+
+    struct DeferredReply {
+        uint32_t token = 0; // 0 is a free slot
+        ProtocolContext context;
+        uint32_t msgid = 0;
+        uint32_t started = 0;
+        TaskHandle_t waiter = nullptr; // http replies are waited on in the server task, for a while
+        bool done = false;
+        JsonDocument result;
+    };
+
+    struct DeferredJob {
+        uint32_t token;
+        DeferredWork work;
+    };
+
+    SemaphoreHandle_t deferredMutex = NULL;
+    etl::array<DeferredReply, YB_PROTOCOL_MAX_DEFERRED> deferred;
+    uint32_t nextDeferredToken = 1;
+    uint32_t deferredCompleted = 0;
+    uint32_t deferredTimeouts = 0;
+    QueueHandle_t deferredJobs = NULL;
+    TaskHandle_t deferredWorker = NULL;
+
+    DeferredReply* findDeferred(uint32_t token);
+    void cancelDeferred(uint32_t token, JsonVariant output);
+    void waitDeferred(uint32_t token, JsonVariant output);
+    void deliverDeferred();
+    void sendDeferred(JsonVariantConst result, ProtocolContext context);
+    static void deferredWorkerTask(void* arg);
+
+    // set_network_config tries the new wifi across several passes of the loop.  the handler
+    // claims it with busy, fills it in, then sets requested.  only the loop connects.
+    struct PendingWifi {
+        std::atomic<bool> busy{false};
+        std::atomic<bool> requested{false};
+        bool connecting = false;
+        uint32_t token = 0;
+        bool reverting = false;
+        char mode[YB_WIFI_MODE_LENGTH];
+        char ssid[YB_WIFI_SSID_LENGTH];
+        char pass[YB_WIFI_PASSWORD_LENGTH];
+    };
+    PendingWifi pendingWifi;
+    void checkPendingWifi();
+
+    // -------------------------------------------------------------------------
+    // inbound rate limiting
+    // -------------------------------------------------------------------------
+    struct RateClient {
+        YBMode mode;
+        uint32_t id;
+        TokenBucket bucket;
+        uint32_t lastSeen = 0;
+        uint32_t dropped = 0;
+        bool limited = false; // only tell them once per streak
+    };
+
+    struct RateTransport {
+        TokenBucket bucket;
+        uint32_t dropped = 0;
+    };
+
+    SemaphoreHandle_t rateMutex = NULL;
+    etl::vector<RateClient, YB_RATE_LIMIT_CLIENTS> rateClients;
+    RateTransport rateTransports[YBP_MODE_MQTT + 1];
+
+    RateClient* findRateClient(YBMode mode, uint32_t id, uint32_t now);
+    void removeRateClient(YBMode mode, uint32_t id);
+    uint32_t commandWeight(const char* cmd, uint8_t count);
+
+    // serial input is read a frame at a time, without ever blocking the loop
+    SerialFramer serialFramer{Serial};
+    YBSerialFraming serialFramingNext = YB_SERIAL_FRAMING_LINE;
+    YBEncoding serialEncoding = YB_ENCODING_JSON;
+
+    void sendToSerial(JsonVariantConst output, UserRole auth_level);
 
     // -------------------------------------------------------------------------
     // Dynamic command handler registry
     // -------------------------------------------------------------------------
     struct CommandEntry {
+        const char* command;
         UserRole role;
         ProtocolMessageHandler handler;
-    };
 
-    // This tells the Map to compare the TEXT, not the memory addresses.
-    struct StringCompare {
-        bool operator()(const char* lhs, const char* rhs) const
-        {
-          return strcmp(lhs, rhs) < 0;
-        }
+        YBLane lane = YB_LANE_CONTROL;
+        uint8_t weight = 1;           // rate limit tokens per call
+        const char* fields = nullptr; // parse filter, see registerCommand()
+
+        // handler runs, how many replied with an error, and how long they took
+        uint32_t calls = 0;
+        uint32_t errors = 0;
+        LatencyHistogram latency;
     };
 
-    // Command map - list of allowed commands, required role, and their callbacks
-    etl::map<const char*, CommandEntry, YB_PROTOCOL_MAX_COMMANDS, StringCompare> commandMap;
+    // list of allowed commands, required role, and their callbacks
+    etl::vector<CommandEntry, YB_PROTOCOL_MAX_COMMANDS> commands;
+
+    // command name -> index into commands.  rebuilt lazily after (un)registering.
+    CommandTable<YB_PROTOCOL_HASH_SIZE> commandTable;
+    std::atomic<bool> commandTableDirty{true};
+
+    // commands and commandTable are read from the http / mqtt tasks and changed from the
+    // main loop.  created in our constructor with xSemaphoreCreateMutexStatic() (no heap, not
+    // in setup()), so it already exists for commands other controllers register before then.
+    SemaphoreHandle_t commandMutex = NULL;
+    StaticSemaphore_t commandMutexBuffer;
+    bool lockCommands();
+    void unlockCommands(bool locked);
+
+    static uint32_t hashCommand(const char* command, uint32_t seed);
+    void buildCommandTable();
+    CommandEntry* findCommand(const char* command); // hold commandMutex
+
+    void generateCommandStats(JsonArray output, bool full);
+
+    // messages that only had the fields their command wanted parsed
+    std::atomic<uint32_t> filteredMessages{0};
+    bool buildFilter(const char* cmd, bool batch, JsonDocument& filter);
 
     void handleSerialJson();
+    void handleSerialFrame(const char* data, size_t len);
+    void handleBatch(JsonArrayConst input, JsonVariant output, ProtocolContext context);
+    void runCommand(JsonVariantConst input, JsonVariant output, ProtocolContext context);
 
     void handleHello(JsonVariantConst input, JsonVariant output, ProtocolContext context);
     void handleLogin(JsonVariantConst input, JsonVariant output, ProtocolContext context);
@@ -120,7 +390,11 @@ class ProtocolController : public BaseController
     void handlePing(JsonVariantConst input, JsonVariant output, ProtocolContext context);
     void handleGetConfig(JsonVariantConst input, JsonVariant output, ProtocolContext context);
     void handleGetStats(JsonVariantConst input, JsonVariant output, ProtocolContext context);
+    void handleGetCommandStats(JsonVariantConst input, JsonVariant output, ProtocolContext context);
+    void handleGetDeferred(JsonVariantConst input, JsonVariant output, ProtocolContext context);
     void handleGetUpdate(JsonVariantConst input, JsonVariant output, ProtocolContext context);
+    void handleSubscribe(JsonVariantConst input, JsonVariant output, ProtocolContext context);
+    void handleUnsubscribe(JsonVariantConst input, JsonVariant output, ProtocolContext context);
     void handleGetFullConfig(JsonVariantConst input, JsonVariant output, ProtocolContext context);
     void handleGetNetworkConfig(JsonVariantConst input, JsonVariant output, ProtocolContext context);
     void handleGetAppConfig(JsonVariantConst input, JsonVariant output, ProtocolContext context);
@@ -44,6 +44,9 @@ class RGBController : public RGBControllerInterface
       _numLeds = numLeds;
       _leds = new CRGB[_numLeds];
 
+      // periodic refresh
+      setLoopInterval(1000);
+
       FastLED.addLeds<LED_TYPE, DATA_PIN, COLOR_ORDER>(_leds, _numLeds);
       FastLED.clear();
       setStatusColor(CRGB::Blue);
@@ -63,12 +66,9 @@ class RGBController : public RGBControllerInterface
 
     void loop() override
     {
-      // 10hz refresh
-      if (millis() - lastRGBUpdateMillis > 1000) {
-        FastLED.setBrightness(maxBrightness * _cfg.globalBrightness);
-        FastLED.show();
-        lastRGBUpdateMillis = millis();
-      }
+      FastLED.setBrightness(maxBrightness * _cfg.globalBrightness);
+      FastLED.show();
+      lastRGBUpdateMillis = this->_app.frame().now_ms; // this-> since YarrboardApp is incomplete here
     }
 
     void generateCapabilitiesHook(JsonVariant config) override
@@ -88,9 +88,11 @@ class RGBController : public RGBControllerInterface
       _leds[c].setRGB(r, g, b);
       FastLED.setBrightness(maxBrightness * _cfg.globalBrightness);
 
-      if (millis() - lastRGBUpdateMillis > 100) {
+      // not always called from the main loop, so read the real clock
+      unsigned long now = millis();
+      if (now - lastRGBUpdateMillis > 100) {
         FastLED.show();
-        lastRGBUpdateMillis = millis();
+        lastRGBUpdateMillis = now;
       }
     }
 
@@ -103,9 +105,11 @@ class RGBController : public RGBControllerInterface
       _leds[c] = color;
       FastLED.setBrightness(maxBrightness * _cfg.globalBrightness);
 
-      if (millis() - lastRGBUpdateMillis > 100) {
+      // not always called from the main loop, so read the real clock
+      unsigned long now = millis();
+      if (now - lastRGBUpdateMillis > 100) {
         FastLED.show();
-        lastRGBUpdateMillis = millis();
+        lastRGBUpdateMillis = now;
       }
     }
 
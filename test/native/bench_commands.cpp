@@ -0,0 +1,111 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+/**
+ * Cost of finding a command by name with 50 registered, each one in turn.
+ *
+ * - linear: strcmp against every entry, the old findCommand().
+ * - sorted map: a strcmp ordered tree, like etl::map<const char*, ...>.
+ * - hash table: CommandTable, what ProtocolController uses now.
+ */
+
+#include "CommandTable.h"
+#include "yb_bench.h"
+#include <map>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct Entry {
+    const char* command;
+    uint32_t calls;
+};
+
+struct NameLess {
+    bool operator()(const char* a, const char* b) const { return strcmp(a, b) < 0; }
+};
+
+static const size_t COMMANDS = 50;
+
+static std::vector<std::string> names()
+{
+  std::vector<std::string> out = {"ping", "hello", "login", "logout", "get_config", "get_stats",
+    "get_command_stats", "get_update", "subscribe", "unsubscribe", "set_theme", "set_brightness",
+    "set_general_config", "save_config", "get_full_config", "get_network_config", "get_app_config",
+    "set_network_config", "set_authentication_config", "set_webserver_config", "set_misc_config",
+    "restart", "factory_reset", "set_mqtt_config", "ota_start", "play_sound"};
+
+  for (int i = 0; out.size() < COMMANDS; i++)
+    out.push_back("set_channel_" + std::to_string(i));
+
+  return out;
+}
+
+int main(int argc, char** argv)
+{
+  uint64_t lookups = ybbench::iterations(argc, argv, 10000000);
+  printf("%d commands, %llu lookups\n", (int)COMMANDS, (unsigned long long)lookups);
+
+  // the incoming names are separate copies, like they would be out of a message
+  std::vector<std::string> strings = names();
+  std::vector<std::string> incoming = strings;
+
+  std::vector<Entry> commands;
+  for (const std::string& s : strings)
+    commands.push_back({s.c_str(), 0});
+
+  std::map<const char*, Entry*, NameLess> sorted;
+  for (Entry& e : commands)
+    sorted[e.command] = &e;
+
+  CommandTable<128> table;
+  table.rebuild(commands);
+
+  size_t i = 0;
+  double linear = ybbench::nsPer(lookups, [&]() {
+    const char* name = incoming[i].c_str();
+    for (Entry& e : commands) {
+      if (!strcmp(e.command, name)) {
+        e.calls++;
+        break;
+      }
+    }
+    i = (i + 1) % COMMANDS;
+  });
+
+  i = 0;
+  double map = ybbench::nsPer(lookups, [&]() {
+    auto it = sorted.find(incoming[i].c_str());
+    if (it != sorted.end())
+      it->second->calls++;
+    i = (i + 1) % COMMANDS;
+  });
+
+  i = 0;
+  double hash = ybbench::nsPer(lookups, [&]() {
+    int index = table.find(commands, incoming[i].c_str());
+    if (index >= 0)
+      commands[index].calls++;
+    i = (i + 1) % COMMANDS;
+  });
+
+  ybbench::report("linear strcmp, per lookup", linear);
+  ybbench::report("sorted map, per lookup", map);
+  ybbench::report("hash table, per lookup", hash);
+  printf("  hash table seed %u, %u extra probes\n", table.seed(), table.probes());
+
+  // all three found one every time
+  uint64_t calls = 0;
+  for (const Entry& e : commands)
+    calls += e.calls;
+  return calls == 3 * lookups ? 0 : 1;
+}
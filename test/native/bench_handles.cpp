@@ -0,0 +1,101 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+/**
+ * Cost of finding a controller with 30 registered.
+ *
+ * - by name: the strcmp walk YarrboardApp::getController("name") does, plus the cast.
+ * - by handle: YarrboardApp::getController(handle), one indexed load and a generation check.
+ *
+ * Every controller is looked up in turn, so the name walk averages half the list.
+ */
+
+#include "ControllerHandle.h"
+#include "yb_bench.h"
+#include <string.h>
+#include <string>
+#include <vector>
+
+class Controller
+{
+  public:
+    Controller(const std::string& name) : name(name) {}
+    virtual ~Controller() {}
+
+    const char* getName() const { return name.c_str(); }
+
+    std::string name;
+    uint32_t calls = 0;
+};
+
+class Typed : public Controller
+{
+  public:
+    using Controller::Controller;
+};
+
+static const size_t CONTROLLERS = 30;
+
+// names like the real ones, sharing prefixes so strcmp has to look past the first byte
+static const char* NAMES[] = {"protocol", "http", "mqtt", "ntp", "network", "ota", "auth", "debug", "rgb", "buzzer"};
+
+static Controller* byName(const std::vector<Controller*>& controllers, const char* name)
+{
+  for (Controller* c : controllers) {
+    if (c->getName() && strcmp(c->getName(), name) == 0)
+      return c;
+  }
+  return nullptr;
+}
+
+int main(int argc, char** argv)
+{
+  uint64_t lookups = ybbench::iterations(argc, argv, 10000000);
+  printf("%d controllers, %llu lookups\n", (int)CONTROLLERS, (unsigned long long)lookups);
+
+  std::vector<Controller*> controllers;
+  std::vector<std::string> names;
+  std::vector<ControllerHandle<Typed>> handles;
+  HandleTable<Controller, CONTROLLERS> table;
+  for (size_t i = 0; i < CONTROLLERS; i++) {
+    std::string name = std::string(NAMES[i % 10]) + (i < 10 ? "" : std::to_string(i / 10));
+    Typed* c = new Typed(name);
+    controllers.push_back(c);
+    names.push_back(name);
+    handles.push_back(table.handle<Typed>(table.add(c)));
+  }
+
+  size_t i = 0;
+  double name = ybbench::nsPer(lookups, [&]() {
+    Typed* c = static_cast<Typed*>(byName(controllers, names[i].c_str()));
+    c->calls++;
+    i = (i + 1) % CONTROLLERS;
+  });
+
+  i = 0;
+  double handle = ybbench::nsPer(lookups, [&]() {
+    Typed* c = table.get(handles[i]);
+    c->calls++;
+    i = (i + 1) % CONTROLLERS;
+  });
+
+  ybbench::report("by name (strcmp), per lookup", name);
+  ybbench::report("by handle, per lookup", handle);
+
+  // both found one every time
+  uint64_t calls = 0;
+  for (Controller* c : controllers) {
+    calls += c->calls;
+    delete c;
+  }
+  return calls == 2 * lookups ? 0 : 1;
+}
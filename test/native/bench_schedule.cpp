@@ -0,0 +1,130 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+/**
+ * Cost of one pass of the main loop with 30 controllers, most of them periodic.
+ *
+ * - every pass: the old way, each loop() is called and checks millis() itself.
+ * - deadline heap: the every-pass controllers, then only the periodic ones that are due.
+ *
+ * The clock is fake and moves 1ms per pass, so both run the same simulated minutes.
+ */
+
+#include "DeadlineHeap.h"
+#include "yb_bench.h"
+#include <Arduino.h>
+#include <vector>
+
+class Controller
+{
+  public:
+    Controller(uint32_t interval) : interval(interval) {}
+    virtual ~Controller() {}
+
+    // the old style, bail out early if it isn't time yet
+    virtual void loop()
+    {
+      if (interval && millis() - lastRun < interval)
+        return;
+      lastRun = millis();
+      work();
+    }
+
+    void work()
+    {
+      runs++;
+      ybbench::sink += runs;
+    }
+
+    uint32_t getNextLoopMillis() { return next; }
+
+    uint32_t interval;
+    uint32_t lastRun = 0;
+    uint32_t next = 0;
+    uint32_t runs = 0;
+};
+
+// a few every-pass ones (protocol, http, ...), the rest periodic like mqtt, navico, rgb, debug
+static const size_t CONTROLLERS = 30;
+static const size_t POLL_CONTROLLERS = 4;
+static const uint32_t INTERVALS[] = {10, 50, 100, 250, 500, 1000, 2000, 5000, 10000};
+
+static std::vector<Controller*> makeControllers()
+{
+  std::vector<Controller*> out;
+  for (size_t i = 0; i < CONTROLLERS; i++) {
+    uint32_t interval = i < POLL_CONTROLLERS ? 0 : INTERVALS[i % (sizeof(INTERVALS) / sizeof(INTERVALS[0]))];
+    out.push_back(new Controller(interval));
+  }
+  return out;
+}
+
+static uint64_t totalRuns(const std::vector<Controller*>& controllers)
+{
+  uint64_t runs = 0;
+  for (Controller* c : controllers) {
+    runs += c->runs;
+    delete c;
+  }
+  return runs;
+}
+
+int main(int argc, char** argv)
+{
+  uint64_t passes = ybbench::iterations(argc, argv, 600000);
+  printf("%d controllers (%d every pass), %llu passes (1ms each)\n", (int)CONTROLLERS, (int)POLL_CONTROLLERS, (unsigned long long)passes);
+
+  // the old way
+  std::vector<Controller*> everyPass = makeControllers();
+  fakeClock::set(0);
+  double linear = ybbench::nsPer(passes, [&]() {
+    for (Controller* c : everyPass)
+      c->loop();
+    fakeClock::advance(1);
+  });
+  uint64_t linearRuns = totalRuns(everyPass);
+
+  // the deadline heap, same as YarrboardApp::_runControllers()
+  std::vector<Controller*> controllers = makeControllers();
+  std::vector<Controller*> poll;
+  DeadlineHeap<Controller, CONTROLLERS> heap;
+  for (Controller* c : controllers) {
+    if (c->interval)
+      heap.push(c);
+    else
+      poll.push_back(c);
+  }
+
+  fakeClock::set(0);
+  double deadline = ybbench::nsPer(passes, [&]() {
+    uint32_t now = millis();
+    for (Controller* c : poll)
+      c->loop();
+
+    while (Controller* c = heap.due(now)) {
+      heap.pop();
+      c->work();
+      c->next = DeadlineHeap<Controller, CONTROLLERS>::advance(c->next, c->interval, now);
+      heap.push(c);
+    }
+    fakeClock::advance(1);
+  });
+  uint64_t deadlineRuns = totalRuns(controllers);
+
+  ybbench::report("every pass, per pass", linear);
+  ybbench::report("deadline heap, per pass", deadline);
+  printf("  loop() runs: %llu vs %llu\n", (unsigned long long)linearRuns, (unsigned long long)deadlineRuns);
+
+  // same work either way, give or take the first run of each one
+  uint64_t diff = linearRuns > deadlineRuns ? linearRuns - deadlineRuns : deadlineRuns - linearRuns;
+  return diff <= CONTROLLERS ? 0 : 1;
+}
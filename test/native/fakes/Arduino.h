@@ -0,0 +1,195 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_FAKE_ARDUINO_H
+#define YARR_FAKE_ARDUINO_H
+
+/**
+ * Just enough of the Arduino core to build the framework's standalone pieces on a PC.
+ *
+ * - the clock only moves when a test moves it, see fakeClock below.
+ * - Serial goes to stdout and never has anything to read.
+ * - StringStream is a Stream over a std::string, for feeding parsers and capturing output.
+ */
+
+#include <algorithm>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+using std::max;
+using std::min;
+
+#define F(s) (s)
+
+// -----------------------------------------------------------------------------
+// time
+// -----------------------------------------------------------------------------
+namespace fakeClock
+{
+  inline uint64_t now_us = 0;
+
+  inline void set(uint32_t ms) { now_us = (uint64_t)ms * 1000; }
+  inline void advance(uint32_t ms) { now_us += (uint64_t)ms * 1000; }
+  inline void advanceMicros(uint32_t us) { now_us += us; }
+} // namespace fakeClock
+
+inline unsigned long millis() { return (unsigned long)(uint32_t)(fakeClock::now_us / 1000); }
+inline unsigned long micros() { return (unsigned long)(uint32_t)fakeClock::now_us; }
+inline void delay(uint32_t ms) { fakeClock::advance(ms); }
+inline void delayMicroseconds(uint32_t us) { fakeClock::advanceMicros(us); }
+inline void yield() {}
+
+// -----------------------------------------------------------------------------
+// Print / Stream
+// -----------------------------------------------------------------------------
+class Print
+{
+  public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* data, size_t len)
+    {
+      size_t n = 0;
+      while (len--)
+        n += write(*data++);
+      return n;
+    }
+
+    size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+    size_t write(const char* data, size_t len) { return write((const uint8_t*)data, len); }
+
+    size_t print(const char* str) { return write(str); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(long n) { return printf("%ld", n); }
+    size_t print(unsigned long n) { return printf("%lu", n); }
+    size_t print(int n) { return print((long)n); }
+    size_t print(unsigned int n) { return print((unsigned long)n); }
+    size_t print(double n, int digits = 2) { return printf("%.*f", digits, n); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(T value)
+    {
+      size_t n = print(value);
+      return n + println();
+    }
+
+    size_t printf(const char* format, ...)
+    {
+      char buf[256];
+      va_list args;
+      va_start(args, format);
+      int len = vsnprintf(buf, sizeof(buf), format, args);
+      va_end(args);
+      if (len < 0)
+        return 0;
+
+      // too big for the stack buffer, do it again on the heap
+      if ((size_t)len >= sizeof(buf)) {
+        std::string big(len + 1, '\0');
+        va_start(args, format);
+        vsnprintf(&big[0], big.size(), format, args);
+        va_end(args);
+        return write((const uint8_t*)big.data(), len);
+      }
+
+      return write((const uint8_t*)buf, len);
+    }
+
+    virtual void flush() {}
+};
+
+class Stream : public Print
+{
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+
+    // never waits, there's nobody on the other end to wait for
+    size_t readBytes(uint8_t* buffer, size_t length)
+    {
+      size_t n = 0;
+      while (n < length) {
+        int c = read();
+        if (c < 0)
+          break;
+        buffer[n++] = (uint8_t)c;
+      }
+      return n;
+    }
+
+    size_t readBytes(char* buffer, size_t length) { return readBytes((uint8_t*)buffer, length); }
+
+  protected:
+    unsigned long _timeout = 1000;
+};
+
+// reads come from `input`, writes pile up in `output`
+class StringStream : public Stream
+{
+  public:
+    std::string input;
+    std::string output;
+    size_t pos = 0;
+
+    // only hand out this many bytes per available(), to fake a slow link.  0 = all of it
+    size_t trickle = 0;
+
+    int available() override
+    {
+      size_t left = input.size() - pos;
+      return (int)(trickle && left > trickle ? trickle : left);
+    }
+
+    int read() override { return pos < input.size() ? (uint8_t)input[pos++] : -1; }
+    int peek() override { return pos < input.size() ? (uint8_t)input[pos] : -1; }
+
+    size_t write(uint8_t c) override
+    {
+      output += (char)c;
+      return 1;
+    }
+
+    size_t write(const uint8_t* data, size_t len) override
+    {
+      output.append((const char*)data, len);
+      return len;
+    }
+
+    using Print::write;
+};
+
+class HardwareSerial : public Stream
+{
+  public:
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+    size_t write(uint8_t c) override { return fwrite(&c, 1, 1, stdout); }
+    size_t write(const uint8_t* data, size_t len) override { return fwrite(data, 1, len, stdout); }
+
+    using Print::write;
+};
+
+inline HardwareSerial Serial;
+
+#endif /* !YARR_FAKE_ARDUINO_H */
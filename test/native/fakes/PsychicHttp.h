@@ -0,0 +1,69 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_FAKE_PSYCHIC_HTTP_H
+#define YARR_FAKE_PSYCHIC_HTTP_H
+
+#include <Arduino.h>
+#include <string>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+/**
+ * PsychicResponse that remembers what it was asked to send instead of sending it.
+ * Set failChunk to make the nth sendChunk() call fail, like a client that went away.
+ */
+class PsychicResponse
+{
+  public:
+    std::string contentType;
+    std::string body;
+    bool sent = false;
+    bool headersSent = false;
+    bool finished = false;
+    int chunks = 0;
+    int failChunk = -1;
+
+    void setContentType(const char* type) { contentType = type; }
+    void setContent(const uint8_t* content, size_t len) { body.assign((const char*)content, len); }
+
+    esp_err_t send()
+    {
+      sent = true;
+      return ESP_OK;
+    }
+
+    esp_err_t sendHeaders()
+    {
+      headersSent = true;
+      return ESP_OK;
+    }
+
+    esp_err_t sendChunk(uint8_t* chunk, size_t len)
+    {
+      if (chunks++ == failChunk)
+        return ESP_FAIL;
+
+      body.append((const char*)chunk, len);
+      return ESP_OK;
+    }
+
+    esp_err_t finishChunking()
+    {
+      finished = true;
+      return ESP_OK;
+    }
+};
+
+#endif /* !YARR_FAKE_PSYCHIC_HTTP_H */
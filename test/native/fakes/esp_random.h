@@ -0,0 +1,28 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_FAKE_ESP_RANDOM_H
+#define YARR_FAKE_ESP_RANDOM_H
+
+#include <stdint.h>
+
+// xorshift32, so every run of the tests sees the same numbers
+inline uint32_t esp_random()
+{
+  static uint32_t state = 2463534242u;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+#endif /* !YARR_FAKE_ESP_RANDOM_H */
@@ -0,0 +1,136 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include "CommandTable.h"
+#include "yb_test.h"
+#include <string>
+#include <vector>
+
+struct Entry {
+    const char* command;
+};
+
+// the built in commands, plus enough made up ones to fill the list
+static std::vector<std::string> names()
+{
+  std::vector<std::string> out = {"ping", "hello", "login", "logout", "get_config", "get_stats",
+    "get_command_stats", "get_update", "subscribe", "unsubscribe", "set_theme", "set_brightness",
+    "set_general_config", "save_config", "get_full_config", "get_network_config", "get_app_config",
+    "set_network_config", "set_authentication_config", "set_webserver_config", "set_misc_config",
+    "restart", "factory_reset", "set_mqtt_config", "ota_start"};
+
+  for (int i = 0; out.size() < 50; i++)
+    out.push_back("set_channel_" + std::to_string(i));
+
+  return out;
+}
+
+static std::vector<Entry> entriesFor(const std::vector<std::string>& strings)
+{
+  std::vector<Entry> entries;
+  for (const std::string& s : strings)
+    entries.push_back({s.c_str()});
+  return entries;
+}
+
+YB_TEST(empty_table_finds_nothing)
+{
+  std::vector<Entry> list;
+  CommandTable<128> table;
+  YB_CHECK_EQ(table.find(list, "ping"), -1);
+
+  table.rebuild(list);
+  YB_CHECK_EQ(table.find(list, "ping"), -1);
+}
+
+YB_TEST(finds_every_command)
+{
+  std::vector<std::string> strings = names();
+  std::vector<Entry> list = entriesFor(strings);
+
+  CommandTable<128> table;
+  table.rebuild(list);
+
+  for (size_t i = 0; i < list.size(); i++)
+    YB_CHECK_EQ(table.find(list, list[i].command), (int)i);
+
+  YB_CHECK_EQ(table.find(list, "get_"), -1);
+  YB_CHECK_EQ(table.find(list, "pingg"), -1);
+  YB_CHECK_EQ(table.find(list, ""), -1);
+  YB_CHECK_EQ(table.find(list, nullptr), -1);
+}
+
+YB_TEST(compares_strings_not_pointers)
+{
+  std::vector<std::string> strings = names();
+  std::vector<Entry> list = entriesFor(strings);
+
+  CommandTable<128> table;
+  table.rebuild(list);
+
+  char copy[32];
+  strcpy(copy, "set_theme");
+  YB_CHECK_EQ(table.find(list, copy), 10);
+}
+
+YB_TEST(seed_search_keeps_probes_low)
+{
+  std::vector<std::string> strings = names();
+  std::vector<Entry> list = entriesFor(strings);
+
+  CommandTable<128> table;
+  table.rebuild(list);
+
+  // 50 names in 128 slots, a few collisions at most
+  YB_CHECK(table.seed() < CommandTable<128>::MAX_SEEDS);
+  YB_CHECK(table.probes() < list.size());
+}
+
+YB_TEST(rebuild_after_removal)
+{
+  std::vector<std::string> strings = names();
+  std::vector<Entry> list = entriesFor(strings);
+
+  CommandTable<128> table;
+  table.rebuild(list);
+
+  list.erase(list.begin());
+  table.rebuild(list);
+
+  YB_CHECK_EQ(table.find(list, "ping"), -1);
+  for (size_t i = 0; i < list.size(); i++)
+    YB_CHECK_EQ(table.find(list, list[i].command), (int)i);
+}
+
+YB_TEST(nearly_full_table)
+{
+  // one empty slot left, a miss has to find it instead of going around forever
+  std::vector<std::string> strings;
+  for (int i = 0; i < 7; i++)
+    strings.push_back("cmd" + std::to_string(i));
+  std::vector<Entry> list = entriesFor(strings);
+
+  CommandTable<8> table;
+  table.rebuild(list);
+  for (size_t i = 0; i < list.size(); i++)
+    YB_CHECK_EQ(table.find(list, list[i].command), (int)i);
+  YB_CHECK_EQ(table.find(list, "nope"), -1);
+}
+
+YB_TEST(hash_is_fnv1a)
+{
+  YB_CHECK_EQ(CommandTable<8>::hash("", 0), 2166136261u);
+  YB_CHECK_EQ(CommandTable<8>::hash("a", 0), 0xE40C292Cu);
+  YB_CHECK(CommandTable<8>::hash("ping", 0) != CommandTable<8>::hash("ping", 1));
+}
+
+YB_TEST_MAIN()
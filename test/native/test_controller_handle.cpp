@@ -0,0 +1,76 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include "ControllerHandle.h"
+#include "yb_test.h"
+#include <type_traits>
+
+struct Base {
+    virtual ~Base() {}
+};
+
+struct Derived : public Base {
+    int value = 42;
+};
+
+// no accidental int conversions, only if (handle)
+static_assert(!std::is_convertible<ControllerHandle<Derived>, bool>::value, "handle should not convert to bool implicitly");
+static_assert(std::is_constructible<bool, ControllerHandle<Derived>>::value, "handle should work in if ()");
+
+YB_TEST(default_handle_is_invalid)
+{
+  HandleTable<Base, 4> table;
+  ControllerHandle<Derived> h;
+  YB_CHECK(!h);
+  YB_CHECK(table.get(h) == nullptr);
+}
+
+YB_TEST(resolves_to_the_derived_type)
+{
+  HandleTable<Base, 4> table;
+  Derived d;
+  int slot = table.add(&d);
+  YB_CHECK_EQ(slot, 0);
+
+  ControllerHandle<Derived> h = table.handle<Derived>(slot);
+  YB_CHECK(h);
+  YB_CHECK(table.get(h) == &d);
+  YB_CHECK_EQ(table.get(h)->value, 42);
+}
+
+YB_TEST(removed_handles_go_stale)
+{
+  HandleTable<Base, 4> table;
+  Derived a;
+  Derived b;
+  ControllerHandle<Derived> old = table.handle<Derived>(table.add(&a));
+  table.remove(&a);
+  YB_CHECK(table.get(old) == nullptr);
+
+  // same slot, new generation
+  ControllerHandle<Derived> h = table.handle<Derived>(table.add(&b));
+  YB_CHECK_EQ(h.slot, old.slot);
+  YB_CHECK(table.get(old) == nullptr);
+  YB_CHECK(table.get(h) == &b);
+}
+
+YB_TEST(full_table)
+{
+  HandleTable<Base, 2> table;
+  Derived a, b, c;
+  YB_CHECK(table.add(&a) >= 0);
+  YB_CHECK(table.add(&b) >= 0);
+  YB_CHECK_EQ(table.add(&c), -1);
+  YB_CHECK(!table.handle<Derived>(-1));
+}
+
+YB_TEST_MAIN()
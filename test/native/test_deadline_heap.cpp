@@ -0,0 +1,88 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include "DeadlineHeap.h"
+#include "yb_test.h"
+
+struct Timer {
+    uint32_t next;
+    uint32_t getNextLoopMillis() { return next; }
+};
+
+YB_TEST(earliest_first)
+{
+  Timer timers[] = {{500}, {100}, {300}, {200}, {400}};
+  DeadlineHeap<Timer, 8> heap;
+  for (Timer& t : timers)
+    YB_CHECK(heap.push(&t));
+
+  YB_CHECK(heap.due(99) == nullptr);
+
+  uint32_t last = 0;
+  while (!heap.empty()) {
+    Timer* t = heap.pop();
+    YB_CHECK(t->next > last);
+    last = t->next;
+  }
+}
+
+YB_TEST(only_due_ones)
+{
+  Timer a = {100};
+  Timer b = {200};
+  DeadlineHeap<Timer, 4> heap;
+  heap.push(&b);
+  heap.push(&a);
+
+  YB_CHECK(heap.due(150) == &a);
+  heap.pop();
+  YB_CHECK(heap.due(150) == nullptr);
+  YB_CHECK(heap.front() == &b);
+}
+
+YB_TEST(deadlines_across_rollover)
+{
+  // 0x10 comes after 0xFFFFFFF0, not before it
+  Timer late = {0x10};
+  Timer early = {0xFFFFFFF0};
+  DeadlineHeap<Timer, 4> heap;
+  heap.push(&late);
+  heap.push(&early);
+
+  YB_CHECK(heap.due(0xFFFFFFF0) == &early);
+  heap.pop();
+  YB_CHECK(heap.due(0xFFFFFFFF) == nullptr);
+  YB_CHECK(heap.due(0x10) == &late);
+}
+
+YB_TEST(full_heap_refuses)
+{
+  Timer t[3] = {{1}, {2}, {3}};
+  DeadlineHeap<Timer, 2> heap;
+  YB_CHECK(heap.push(&t[0]));
+  YB_CHECK(heap.push(&t[1]));
+  YB_CHECK(!heap.push(&t[2]));
+  YB_CHECK_EQ(heap.size(), 2u);
+}
+
+YB_TEST(advance_skips_missed_runs)
+{
+  typedef DeadlineHeap<Timer, 1> Heap;
+
+  // on time, keeps the cadence
+  YB_CHECK_EQ(Heap::advance(1000, 100, 1005), 1100u);
+
+  // way behind, no burst of catch up runs
+  YB_CHECK_EQ(Heap::advance(1000, 100, 1550), 1650u);
+}
+
+YB_TEST_MAIN()
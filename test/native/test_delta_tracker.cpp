@@ -0,0 +1,96 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include "DeltaTracker.h"
+#include "yb_test.h"
+#include <string>
+
+static void makeState(JsonDocument& state, uint32_t uptime, bool ch2)
+{
+  state.clear();
+  state["msg"] = "update";
+  state["uptime"] = uptime;
+  JsonArray channels = state["relay"].to<JsonArray>();
+  for (int id = 1; id <= 3; id++) {
+    JsonObject ch = channels.add<JsonObject>();
+    ch["id"] = id;
+    ch["state"] = id == 2 ? ch2 : false;
+  }
+}
+
+YB_TEST(same_state_same_version)
+{
+  DeltaTracker tracker;
+  JsonDocument state;
+  makeState(state, 1, false);
+
+  uint32_t v1 = tracker.update(state.as<JsonVariantConst>());
+  YB_CHECK(v1 != 0);
+  YB_CHECK_EQ(tracker.update(state.as<JsonVariantConst>()), v1);
+  YB_CHECK(tracker.canDelta(v1));
+  YB_CHECK(!tracker.canDelta(0));
+  YB_CHECK(!tracker.canDelta(v1 + 1));
+}
+
+YB_TEST(delta_has_only_changes)
+{
+  DeltaTracker tracker;
+  JsonDocument state;
+  makeState(state, 1, false);
+  uint32_t v1 = tracker.update(state.as<JsonVariantConst>());
+
+  makeState(state, 1, true);
+  uint32_t v2 = tracker.update(state.as<JsonVariantConst>());
+  YB_CHECK_EQ(v2, v1 + 1);
+
+  JsonDocument delta;
+  tracker.generateDelta(state.as<JsonVariantConst>(), v1, delta.to<JsonObject>());
+
+  // only channel 2 changed, and it keeps its id so the client knows which one
+  YB_CHECK(delta["uptime"].isNull());
+  YB_CHECK(delta["msg"].isNull());
+  YB_CHECK_EQ(delta["relay"].size(), 1u);
+  YB_CHECK_EQ(delta["relay"][0]["id"].as<int>(), 2);
+  YB_CHECK_EQ(delta["relay"][0]["state"].as<bool>(), true);
+
+  // nothing new since v2
+  JsonDocument none;
+  tracker.generateDelta(state.as<JsonVariantConst>(), v2, none.to<JsonObject>());
+  YB_CHECK_EQ(none.size(), 0u);
+}
+
+YB_TEST(old_version_gets_everything)
+{
+  DeltaTracker tracker;
+  JsonDocument state;
+  makeState(state, 1, false);
+  uint32_t v1 = tracker.update(state.as<JsonVariantConst>());
+
+  JsonDocument delta;
+  tracker.generateDelta(state.as<JsonVariantConst>(), v1 - 1, delta.to<JsonObject>());
+  YB_CHECK_EQ(delta["uptime"].as<int>(), 1);
+  YB_CHECK_EQ(delta["relay"].size(), 3u);
+}
+
+YB_TEST(table_overflow_is_counted)
+{
+  DeltaTracker tracker;
+  JsonDocument state;
+  for (int i = 0; i < YB_UPDATE_FIELD_TABLE_SIZE; i++)
+    state["field" + std::to_string(i)] = i;
+
+  tracker.update(state.as<JsonVariantConst>());
+  YB_CHECK_EQ(tracker.fieldCount(), YB_UPDATE_FIELD_TABLE_SIZE * 3 / 4);
+  YB_CHECK(tracker.overflows > 0);
+}
+
+YB_TEST_MAIN()
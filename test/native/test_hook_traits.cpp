@@ -0,0 +1,60 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include "HookTraits.h"
+#include "yb_test.h"
+
+struct Base {
+    virtual ~Base() {}
+    virtual void update(int out) {}
+    virtual bool needsFast() { return false; }
+};
+
+// overrides update and adds its own overload of the name
+struct Overloaded : public Base {
+    void update(int out) override {}
+    void update(const char* out) {}
+};
+
+// picks up update from an intermediate class
+struct Middle : public Base {
+    void update(int out) override {}
+};
+struct Leaf : public Middle {
+    bool needsFast() override { return true; }
+};
+
+// overloads the name but doesn't override the hook
+struct OnlyExtra : public Base {
+    using Base::update;
+    void update(const char* out) {}
+};
+
+YB_TEST(not_overridden)
+{
+  YB_CHECK((std::is_same<YB_HOOK_OWNER(Base, Base, update), Base>::value));
+  YB_CHECK((std::is_same<YB_HOOK_OWNER(Overloaded, Base, needsFast), Base>::value));
+}
+
+YB_TEST(overloads_are_not_ambiguous)
+{
+  YB_CHECK((std::is_same<YB_HOOK_OWNER(Overloaded, Base, update), Overloaded>::value));
+  YB_CHECK((std::is_same<YB_HOOK_OWNER(OnlyExtra, Base, update), Base>::value));
+}
+
+YB_TEST(intermediate_classes_count)
+{
+  YB_CHECK((std::is_same<YB_HOOK_OWNER(Leaf, Base, update), Middle>::value));
+  YB_CHECK((std::is_same<YB_HOOK_OWNER(Leaf, Base, needsFast), Leaf>::value));
+}
+
+YB_TEST_MAIN()
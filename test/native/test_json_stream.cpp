@@ -0,0 +1,115 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include "JsonStream.h"
+#include "yb_test.h"
+#include <string>
+
+// a few buffers worth
+static void makeBig(JsonDocument& doc)
+{
+  JsonArray values = doc["values"].to<JsonArray>();
+  for (int i = 0; i < 500; i++)
+    values.add(i);
+}
+
+YB_TEST(print_stream_matches_serialize)
+{
+  JsonDocument doc;
+  makeBig(doc);
+  std::string expected;
+  serializeJson(doc, expected);
+
+  StringStream out;
+  PrintJsonStream stream(out);
+  YB_CHECK(stream.sendJson(doc.as<JsonVariantConst>()));
+  YB_CHECK_EQ(out.output, expected);
+  YB_CHECK_EQ(stream.bytesSent(), expected.size());
+}
+
+YB_TEST(small_http_reply_is_not_chunked)
+{
+  JsonDocument doc;
+  doc["msg"] = "ok";
+
+  PsychicResponse response;
+  HTTPJsonStream stream(&response);
+  YB_CHECK(stream.sendJson(doc.as<JsonVariantConst>()));
+
+  YB_CHECK(response.sent);
+  YB_CHECK(!response.headersSent);
+  YB_CHECK_EQ(response.contentType, "application/json");
+  YB_CHECK_EQ(response.body, "{\"msg\":\"ok\"}");
+}
+
+YB_TEST(exactly_one_buffer_is_not_chunked)
+{
+  // the last chunk is held back, so a full buffer still goes out in one piece
+  JsonDocument doc;
+  doc.set(std::string(YB_JSON_STREAM_BUFFER_SIZE - 2, 'x'));
+
+  PsychicResponse response;
+  HTTPJsonStream stream(&response);
+  YB_CHECK(stream.sendJson(doc.as<JsonVariantConst>()));
+  YB_CHECK(response.sent);
+  YB_CHECK_EQ(response.body.size(), (size_t)YB_JSON_STREAM_BUFFER_SIZE);
+}
+
+YB_TEST(big_http_reply_is_chunked)
+{
+  JsonDocument doc;
+  makeBig(doc);
+  std::string expected;
+  serializeJson(doc, expected);
+
+  PsychicResponse response;
+  HTTPJsonStream stream(&response);
+  YB_CHECK(stream.sendJson(doc.as<JsonVariantConst>()));
+
+  YB_CHECK(!response.sent);
+  YB_CHECK(response.headersSent);
+  YB_CHECK(response.finished);
+  YB_CHECK(response.chunks > 1);
+  YB_CHECK_EQ(response.body, expected);
+}
+
+YB_TEST(failed_chunk_aborts)
+{
+  JsonDocument doc;
+  makeBig(doc);
+
+  PsychicResponse response;
+  response.failChunk = 0;
+  HTTPJsonStream stream(&response);
+  YB_CHECK(!stream.sendJson(doc.as<JsonVariantConst>()));
+
+  YB_CHECK_EQ(stream.error(), ESP_FAIL);
+  YB_CHECK_EQ(response.chunks, 1);
+  YB_CHECK(!response.finished);
+  YB_CHECK_EQ(stream.bytesSent(), 0u);
+}
+
+YB_TEST(msgpack_stream)
+{
+  JsonDocument doc;
+  makeBig(doc);
+  std::string expected;
+  serializeMsgPack(doc, expected);
+
+  PsychicResponse response;
+  HTTPJsonStream stream(&response, "application/msgpack");
+  YB_CHECK(stream.sendMsgPack(doc.as<JsonVariantConst>()));
+  YB_CHECK_EQ(response.contentType, "application/msgpack");
+  YB_CHECK_EQ(response.body, expected);
+}
+
+YB_TEST_MAIN()
@@ -0,0 +1,84 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include "LatencyHistogram.h"
+#include "yb_test.h"
+
+YB_TEST(buckets_are_powers_of_two)
+{
+  YB_CHECK_EQ(LatencyHistogram::bucketFor(0), 0);
+  YB_CHECK_EQ(LatencyHistogram::bucketFor(1), 1);
+  YB_CHECK_EQ(LatencyHistogram::bucketFor(2), 2);
+  YB_CHECK_EQ(LatencyHistogram::bucketFor(3), 2);
+  YB_CHECK_EQ(LatencyHistogram::bucketFor(4), 3);
+  YB_CHECK_EQ(LatencyHistogram::bucketFor(0xFFFFFFFF), LatencyHistogram::BUCKETS - 1);
+
+  YB_CHECK_EQ(LatencyHistogram::bucketTop(0), 0u);
+  YB_CHECK_EQ(LatencyHistogram::bucketTop(3), 7u);
+}
+
+YB_TEST(empty_histogram)
+{
+  LatencyHistogram h;
+  YB_CHECK_EQ(h.percentile(50), 0u);
+  YB_CHECK_EQ(h.average(), 0u);
+}
+
+YB_TEST(percentiles_within_2x)
+{
+  LatencyHistogram h;
+  for (uint32_t us = 1; us <= 1000; us++)
+    h.add(us);
+
+  YB_CHECK_EQ(h.count, 1000u);
+  YB_CHECK_EQ(h.max, 1000u);
+  YB_CHECK_EQ(h.average(), 500u);
+
+  uint32_t p50 = h.percentile(50);
+  YB_CHECK(p50 >= 500 && p50 < 1000);
+
+  uint32_t p99 = h.percentile(99);
+  YB_CHECK(p99 >= 990 && p99 <= 1000);
+
+  // never above the real max
+  YB_CHECK(h.percentile(100) <= h.max);
+}
+
+YB_TEST(outliers_land_in_last_bucket)
+{
+  LatencyHistogram h;
+  h.add(10);
+  h.add(0x7FFFFFFF);
+  YB_CHECK_EQ(h.buckets[LatencyHistogram::BUCKETS - 1], 1u);
+  YB_CHECK_EQ(h.percentile(100), 0x7FFFFFFFu);
+}
+
+YB_TEST(generate_stats)
+{
+  LatencyHistogram h;
+  h.add(3);
+  h.add(5);
+
+  JsonDocument doc;
+  h.generateStats(doc.to<JsonObject>(), true);
+  YB_CHECK_EQ(doc["avg_us"].as<uint32_t>(), 4u);
+  YB_CHECK_EQ(doc["max_us"].as<uint32_t>(), 5u);
+  YB_CHECK_EQ(doc["buckets"].size(), (size_t)LatencyHistogram::BUCKETS);
+  YB_CHECK_EQ(doc["buckets"][2].as<uint32_t>(), 1u);
+  YB_CHECK_EQ(doc["buckets"][3].as<uint32_t>(), 1u);
+
+  h.clear();
+  YB_CHECK_EQ(h.count, 0u);
+  YB_CHECK_EQ(h.max, 0u);
+}
+
+YB_TEST_MAIN()
@@ -0,0 +1,156 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include "SerialFramer.h"
+#include "yb_test.h"
+#include <string>
+
+static std::string frameOf(const SerialFramer& framer)
+{
+  return std::string(framer.frame(), framer.frameLength());
+}
+
+static std::string cobsEncode(const std::string& data)
+{
+  StringStream out;
+  CobsPrint cobs(out);
+  cobs.write((const uint8_t*)data.data(), data.size());
+  cobs.end();
+  return out.output;
+}
+
+YB_TEST(line_frames)
+{
+  StringStream port;
+  port.input = "{\"cmd\":\"ping\"}\r\n\n{\"cmd\":\"hello\"} \n";
+  SerialFramer framer(port);
+
+  YB_CHECK(framer.poll());
+  YB_CHECK_EQ(frameOf(framer), "{\"cmd\":\"ping\"}");
+
+  // stays put until it is consumed
+  YB_CHECK(framer.poll());
+  framer.consume();
+
+  // blank line skipped, trailing space trimmed
+  YB_CHECK(framer.poll());
+  YB_CHECK_EQ(frameOf(framer), "{\"cmd\":\"hello\"}");
+  framer.consume();
+
+  YB_CHECK(!framer.poll());
+  YB_CHECK_EQ(framer.frames, 2u);
+}
+
+YB_TEST(partial_frames_wait)
+{
+  StringStream port;
+  port.trickle = 3;
+  port.input = "{\"cmd\":";
+  SerialFramer framer(port);
+
+  YB_CHECK(!framer.poll());
+
+  port.input += "\"ping\"}\n";
+  YB_CHECK(framer.poll());
+  YB_CHECK_EQ(frameOf(framer), "{\"cmd\":\"ping\"}");
+}
+
+YB_TEST(oversized_frame_is_dropped)
+{
+  StringStream port;
+  port.input = std::string(YB_SERIAL_RX_BUFFER_SIZE + 500, 'x') + "\nok\n";
+  SerialFramer framer(port);
+
+  YB_CHECK(framer.poll());
+  YB_CHECK_EQ(frameOf(framer), "ok");
+  YB_CHECK_EQ(framer.overflows, 1u);
+}
+
+YB_TEST(cobs_encoding)
+{
+  YB_CHECK_EQ(cobsEncode(std::string("\x11\x22\x00\x33", 4)), std::string("\x03\x11\x22\x02\x33", 5));
+  YB_CHECK_EQ(cobsEncode(""), "\x01");
+  YB_CHECK_EQ(cobsEncode(std::string(1, '\0')), std::string("\x01\x01", 2));
+}
+
+YB_TEST(cobs_roundtrip)
+{
+  // zeros, a run longer than one block, and every byte value
+  std::string payload;
+  for (int i = 0; i < 600; i++)
+    payload += (char)(i % 300 < 256 ? i % 256 : 0x41);
+
+  std::string encoded = cobsEncode(payload);
+  YB_CHECK(encoded.find('\0') == std::string::npos);
+
+  std::string buf = encoded;
+  size_t len = 0;
+  YB_CHECK(SerialFramer::cobsDecode((uint8_t*)&buf[0], buf.size(), len));
+  YB_CHECK_EQ(std::string(buf.data(), len), payload);
+}
+
+YB_TEST(cobs_rejects_garbage)
+{
+  std::string bad("\x05\x11\x22", 3);
+  size_t len = 0;
+  YB_CHECK(!SerialFramer::cobsDecode((uint8_t*)&bad[0], bad.size(), len));
+}
+
+YB_TEST(cobs_frames_resync_past_log_text)
+{
+  StringStream wire;
+  SerialFramer writer(wire);
+  writer.setFraming(YB_SERIAL_FRAMING_COBS);
+
+  std::string payload("bin\0ary", 7);
+  writer.writeFrame(payload.data(), payload.size());
+
+  StringStream port;
+  port.input = "some log line\n" + wire.output;
+  SerialFramer reader(port);
+  reader.setFraming(YB_SERIAL_FRAMING_COBS);
+
+  YB_CHECK(reader.poll());
+  YB_CHECK_EQ(frameOf(reader), payload);
+  YB_CHECK_EQ(reader.errors, 1u);
+}
+
+YB_TEST(write_json_frames)
+{
+  JsonDocument doc;
+  doc["cmd"] = "ping";
+
+  StringStream line;
+  SerialFramer lineFramer(line);
+  lineFramer.writeFrame(doc.as<JsonVariantConst>());
+  YB_CHECK_EQ(line.output, "{\"cmd\":\"ping\"}\r\n");
+  YB_CHECK_EQ(lineFramer.bytesJson, 14u);
+
+  StringStream wire;
+  SerialFramer writer(wire);
+  writer.setFraming(YB_SERIAL_FRAMING_COBS);
+  writer.writeFrame(doc.as<JsonVariantConst>(), true);
+  YB_CHECK(writer.bytesMsgPack > 0);
+  YB_CHECK_EQ(writer.bytesJson, 0u);
+
+  StringStream port;
+  port.input = wire.output;
+  SerialFramer reader(port);
+  reader.setFraming(YB_SERIAL_FRAMING_COBS);
+  YB_CHECK(reader.poll());
+
+  JsonDocument back;
+  YB_CHECK(!deserializeMsgPack(back, reader.frame(), reader.frameLength()));
+  YB_CHECK_EQ(std::string(back["cmd"].as<const char*>()), "ping");
+}
+
+YB_TEST_MAIN()
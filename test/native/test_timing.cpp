@@ -0,0 +1,80 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include "IntervalTimer.h"
+#include "RollingAverage.h"
+#include "yb_test.h"
+
+YB_TEST(rolling_average_window)
+{
+  fakeClock::set(0);
+  RollingAverage avg(8, 1000);
+
+  avg.add(10);
+  fakeClock::advance(500);
+  avg.add(20);
+  YB_CHECK_EQ(avg.average(), 15u);
+  YB_CHECK_EQ(avg.count(), 2u);
+  YB_CHECK_EQ(avg.latest(), 20u);
+
+  // the first sample falls out of the window
+  fakeClock::advance(600);
+  YB_CHECK_EQ(avg.average(), 20u);
+  YB_CHECK_EQ(avg.count(), 1u);
+
+  fakeClock::advance(1000);
+  YB_CHECK_EQ(avg.average(), 0u);
+}
+
+YB_TEST(rolling_average_overwrites_oldest)
+{
+  RollingAverage avg(4, 1000);
+  for (uint32_t i = 1; i <= 6; i++)
+    avg.add(i, 100);
+
+  YB_CHECK_EQ(avg.count(100), 4u);
+  YB_CHECK_EQ(avg.get(0, 100), 3u);
+  YB_CHECK_EQ(avg.average(100, false), avg.average(100, true));
+}
+
+YB_TEST(interval_timer_averages)
+{
+  StringStream out;
+  IntervalTimer timer(out);
+
+  timer.start(0);
+  timer.time("a", 100);
+  timer.time("b", 400);
+  timer.start(1000);
+  timer.time("a", 1300);
+
+  const auto& entries = timer.getEntries();
+  YB_CHECK_EQ(entries.size(), 2u);
+  YB_CHECK_EQ(entries[0].total_us, 400u);
+  YB_CHECK_EQ(entries[0].count, 2u);
+  YB_CHECK_EQ(entries[1].total_us, 300u);
+
+  timer.print();
+  YB_CHECK(out.output.find("a: avg=200 us") != std::string::npos);
+}
+
+YB_TEST(interval_timer_rollover)
+{
+  StringStream out;
+  IntervalTimer timer(out);
+
+  timer.start(0xFFFFFFF0);
+  timer.time("wrap", 0x10);
+  YB_CHECK_EQ(timer.getEntries()[0].total_us, 0x20u);
+}
+
+YB_TEST_MAIN()
@@ -0,0 +1,89 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#include "TokenBucket.h"
+#include "yb_test.h"
+
+YB_TEST(rate_zero_is_unlimited)
+{
+  TokenBucket bucket;
+  bucket.configure(0, 0);
+  for (int i = 0; i < 1000; i++) {
+    YB_CHECK(bucket.has(100, 0));
+    bucket.take(100);
+  }
+}
+
+YB_TEST(starts_full_and_drains)
+{
+  TokenBucket bucket;
+  bucket.configure(10, 5);
+  YB_CHECK_EQ(bucket.tokens(), 5u);
+
+  for (int i = 0; i < 5; i++) {
+    YB_CHECK(bucket.has(1, 0));
+    bucket.take(1);
+  }
+  YB_CHECK(!bucket.has(1, 0));
+}
+
+YB_TEST(burst_defaults_to_rate)
+{
+  TokenBucket bucket;
+  bucket.configure(7, 0);
+  YB_CHECK_EQ(bucket.tokens(), 7u);
+}
+
+YB_TEST(refills_in_thousandths)
+{
+  // one token a second, so half a second is half a token
+  TokenBucket bucket;
+  bucket.configure(1, 1);
+  bucket.has(1, 1000);
+  bucket.take(1);
+
+  YB_CHECK(!bucket.has(1, 1500));
+  YB_CHECK(bucket.has(1, 2000));
+}
+
+YB_TEST(refill_stops_at_burst)
+{
+  TokenBucket bucket;
+  bucket.configure(100, 10);
+  bucket.has(10, 0);
+  bucket.take(10);
+
+  // a long quiet spell only gets you the burst back
+  YB_CHECK(bucket.has(10, 3600000));
+  YB_CHECK(!bucket.has(11, 3600000));
+}
+
+YB_TEST(survives_millis_rollover)
+{
+  TokenBucket bucket;
+  bucket.configure(10, 10);
+  bucket.has(10, 0xFFFFFF00);
+  bucket.take(10);
+
+  // 0x100 + 0x100 ms later, across the wrap
+  YB_CHECK(bucket.has(5, 0x100));
+}
+
+YB_TEST(reconfigure_clamps_tokens)
+{
+  TokenBucket bucket;
+  bucket.configure(10, 10);
+  bucket.configure(10, 2);
+  YB_CHECK_EQ(bucket.tokens(), 2u);
+}
+
+YB_TEST_MAIN()
@@ -0,0 +1,56 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_BENCH_H
+#define YARR_BENCH_H
+
+/**
+ * Wall clock helpers for the host benchmarks.  These are PC numbers, only the
+ * ratio between two paths means anything for the board.
+ *
+ * Every bench_* takes an optional iteration count, ctest runs them with a small one
+ * so they stay working without slowing the tests down.
+ */
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace ybbench
+{
+  // keeps the optimizer from throwing away the work
+  inline volatile uint32_t sink = 0;
+
+  template <typename Func>
+  double nsPer(uint64_t iterations, Func&& func)
+  {
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; i++)
+      func();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+  }
+
+  inline uint64_t iterations(int argc, char** argv, uint64_t fallback)
+  {
+    return argc > 1 ? strtoull(argv[1], nullptr, 10) : fallback;
+  }
+
+  inline void report(const char* name, double ns)
+  {
+    printf("  %-32s %10.1f ns\n", name, ns);
+  }
+} // namespace ybbench
+
+#endif /* !YARR_BENCH_H */
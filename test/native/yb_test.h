@@ -0,0 +1,88 @@
+/*
+ * Yarrboard Framework
+ *
+ * Copyright (c) 2025 Zach Hoeken <hoeken@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ */
+
+#ifndef YARR_TEST_H
+#define YARR_TEST_H
+
+/**
+ * Tiny test runner for the host build.  Each test_*.cpp is its own executable.
+ *
+ *   YB_TEST(bucket_starts_full) { YB_CHECK_EQ(bucket.tokens(), 5); }
+ *
+ * A failed check prints where it was and marks the test failed, then the test keeps going.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+namespace ybtest
+{
+  typedef void (*TestFunc)();
+
+  struct Test {
+      const char* name;
+      TestFunc func;
+  };
+
+  inline std::vector<Test>& registry()
+  {
+    static std::vector<Test> tests;
+    return tests;
+  }
+
+  inline int failures = 0;
+
+  struct Registrar {
+      Registrar(const char* name, TestFunc func) { registry().push_back({name, func}); }
+  };
+
+  inline void fail(const char* file, int line, const char* expr)
+  {
+    printf("  %s:%d: check failed: %s\n", file, line, expr);
+    failures++;
+  }
+
+  inline int runAll()
+  {
+    int failed = 0;
+    for (const Test& t : registry()) {
+      int before = failures;
+      t.func();
+      bool ok = failures == before;
+      if (!ok)
+        failed++;
+      printf("%s %s\n", ok ? "[ ok ]" : "[FAIL]", t.name);
+    }
+
+    printf("%d/%d passed\n", (int)registry().size() - failed, (int)registry().size());
+    return failed ? 1 : 0;
+  }
+} // namespace ybtest
+
+#define YB_TEST(name)                                            \
+  static void name();                                            \
+  static ybtest::Registrar name##_registrar(#name, name);        \
+  static void name()
+
+#define YB_CHECK(expr)                            \
+  do {                                            \
+    if (!(expr))                                  \
+      ybtest::fail(__FILE__, __LINE__, #expr);    \
+  } while (0)
+
+#define YB_CHECK_EQ(a, b) YB_CHECK((a) == (b))
+
+#define YB_TEST_MAIN() \
+  int main() { return ybtest::runAll(); }
+
+#endif /* !YARR_TEST_H */